@@ -9,18 +9,26 @@
 
 #include "imgutil.h"
 #include "formatter.h"
+#include "prescan.h"
+#include "scheduler.h"
+#include "watchdog.h"
+#include "summary.h"
 // opencv headers
 #include <cv.h>
 #include <highgui.h>
 // c++ headers
 #include <iostream>
 #include <vector>
+#include <deque>
 #include <string>
 #include <fstream>
+#include <cstdlib>
+#include <unistd.h>
 // boost headers
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/program_options.hpp>
+#include <boost/thread.hpp>
 
 using namespace cv;
 using namespace std;
@@ -29,8 +37,26 @@ using namespace boost::filesystem;
 path target_path;
 path output_name = "output.txt";    // default output filename
 vector<path> working_set;	// this vec holds rel. path of all workable .jpgs
+vector<imginfo> scanned_set;    // prescanned working_set minus rejected files
 bool recurse_flag = false;
 bool read_config = false;
+imgopts options;    // analysis options handed to every imgutil
+unsigned int jobs = 0;  // worker threads, 0 picks the number of cores
+scheduler *work = NULL;
+formatter *fm = NULL;   // created by the writer from the first record
+summary *sums = NULL;   // per directory aggregates, created with fm
+path summary_name;
+deque<featurerecord> write_queue;   // finished records waiting for the writer
+boost::mutex queue_lock;
+boost::condition_variable queued;
+bool workers_done = false;  // no more records will be queued
+boost::mutex error_lock;    // serializes error log output
+path error_name;            // sidecar log of images that failed
+std::ofstream error_log;        // opened on the first failure
+double budget = 0;          // per image time budget in seconds, 0 = none
+double max_mem = 0;         // memory budget for images in flight, 0 = none
+unsigned int prefetch_window = 4;   // upcoming images read ahead, 0 = off
+watchdog *dog = NULL;
 enum loglevels {
     SILENT,
     NORMAL,
@@ -61,6 +87,148 @@ void search_path(path p, bool recurse) {	// path must be to a directory
     }
 }
 
+// appends a failed image and the reason to the sidecar error log
+void record_failure(const string &file, const string &reason) {
+    boost::mutex::scoped_lock guard(error_lock);
+    if (!error_log.is_open()) {
+        error_log.open(error_name.string().c_str());
+    }
+    error_log << file << "\t" << reason << endl;
+    if (log_level != SILENT) {
+        cerr << "failed " << file << " [" << reason << "]" << endl;
+    }
+}
+
+// reads the frame header of every file in working_set, files that can not
+// be analyzed are logged and left out of scanned_set
+void prescan_set() {
+    for (vector<path>::iterator iter = working_set.begin(); iter != working_set.end(); ++iter) {
+        imginfo info;
+        string reason;
+        if (prescan(*iter, info, reason)) {
+            info.bytes = imgutil::footprint(info.width, info.height, options);
+            scanned_set.push_back(info);
+        }
+        else {
+            record_failure(iter->string(), reason);
+        }
+    }
+}
+
+// parses a memory size such as 512M or 16G, plain numbers are megabytes
+bool parse_mem(const string &text, double &bytes) {
+    char *end;
+    double value = strtod(text.c_str(), &end);
+    string unit = boost::to_upper_copy(string(end));
+    if (end == text.c_str() || value <= 0) {
+        return false;
+    }
+    if (unit == "" || unit == "M" || unit == "MB") {
+        bytes = value * 1024 * 1024;
+    }
+    else if (unit == "G" || unit == "GB") {
+        bytes = value * 1024 * 1024 * 1024;
+    }
+    else if (unit == "K" || unit == "KB") {
+        bytes = value * 1024;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+// hands a finished record to the writer, the results are swapped into the
+// queue rather than copied
+void enqueue(featurerecord &rec) {
+    boost::mutex::scoped_lock guard(queue_lock);
+    write_queue.push_back(featurerecord());
+    write_queue.back().swap(rec);
+    queued.notify_one();
+}
+
+// writer thread body, formats records in the order they finish, which
+// varies between runs with several workers (see README)
+void writer() {
+    featurerecord rec;
+    for (;;) {
+        {
+            boost::mutex::scoped_lock guard(queue_lock);
+            while (write_queue.empty() && !workers_done) {
+                queued.wait(guard);
+            }
+            if (write_queue.empty()) {
+                return;
+            }
+            rec.swap(write_queue.front());
+            write_queue.pop_front();
+        }
+        if (fm == NULL) {
+            fm = new formatter(rec, output_name.string());
+            sums = new summary(fm->get_columns());
+        }
+        else {
+            fm->append(rec);
+        }
+        // grouped by the directory the image came from, e.g. site or dive
+        sums->add(path(rec.name).parent_path().string(), fm->last_row());
+        if (log_level >= VERBOSE) {
+            cout << "done " << rec.name << endl;
+        }
+    }
+}
+
+// worker thread body, analyzes images until the scheduler runs dry. An
+// image that throws or runs over budget is logged and skipped.
+void worker(workerstate *self) {
+    imginfo job;
+    while (!dog->abandoned(self) && work->next(job)) {
+        const string file = job.file.string();
+        string failure;
+        bool abandoned = false;
+        dog->begin(self, file);
+        try {
+            featurerecord rec;
+            imgutil iu(file, options);  // only the record is left afterwards
+            iu.take_record(rec);
+            watchdog::outcome result = dog->end(self);
+            if (result == watchdog::ABANDONED) {
+                abandoned = true;
+            }
+            else if (result == watchdog::OVERRAN) {
+                failure = "exceeded time budget";
+            }
+            else {
+                enqueue(rec);
+            }
+        }
+        catch (const boost::thread_interrupted &) {
+            abandoned = dog->end(self) == watchdog::ABANDONED;
+            failure = "exceeded time budget";
+        }
+        catch (const std::exception &ex) {     // imgerror, cv::Exception, bad_alloc
+            abandoned = dog->end(self) == watchdog::ABANDONED;
+            failure = ex.what();
+        }
+        // the matrices are gone now, an abandoned image was charged until here
+        work->done(file);
+        if (abandoned) {
+            break;  // already logged, the run has moved on
+        }
+        if (!failure.empty()) {
+            record_failure(file, failure);
+        }
+    }
+    dog->exited(self);
+}
+
+// watchdog callback for a worker stuck in one image past twice the
+// budget, the watchdog has already started its replacement. The image
+// keeps its memory charged until the stuck worker unwinds.
+void abandon_image(const string &file) {
+    record_failure(file, "stalled past time budget, worker abandoned");
+    work->abandon(file);
+}
 
 int main( int argc, char* argv[] )
 {
@@ -75,6 +243,21 @@ int main( int argc, char* argv[] )
 		        ("r", "recurse through directory and all sub-directories\n")
 		        ("version", "print current software version\n")
 		        ("c", "reads all options from conf.d file in current working directory\n")
+		        ("sample", boost::program_options::value<double>(), "estimate colors, Laplace and Canny sums from a\n"
+		                "stratified fraction (0,1] of image tiles, adds 95% interval columns\n")
+		        ("pyramid", boost::program_options::value<int>(), "also analyze edge and Laplace features on N-1 pyrDown\n"
+		                "levels, columns are prefixed base-L1-, norm-L1-, ...\n")
+		        ("j", boost::program_options::value<unsigned int>(), "number of worker threads, defaults to one per core\n")
+		        ("show", "display each image before analysis, waits for a keypress (single worker)\n")
+		        ("budget", boost::program_options::value<double>(), "per image time budget in seconds, images over it are\n"
+		                "skipped and logged\n")
+		        ("max-mem", boost::program_options::value<string>(), "memory budget for images analyzed at once e.g. 8G,\n"
+		                "plain numbers are megabytes\n")
+		        ("summary", boost::program_options::value<string>(), "specify per directory summary file name, defaults to\n"
+		                "output name + .summary\n")
+		        ("prefetch", boost::program_options::value<unsigned int>(), "number of upcoming images to read ahead, default 4,\n"
+		                "0 turns readahead off\n")
+		        ("e", boost::program_options::value<string>(), "specify error log name, defaults to output name + .err\n")
 		        ("w", boost::program_options::value<string>(), "specify output file name")
 		        ("p", boost::program_options::value<string>(), "specify input path\n");
     // image directory to be worked on is only "positional option"
@@ -105,6 +288,14 @@ int main( int argc, char* argv[] )
     if (vm.count("w")) {    // set output file name
         output_name = vm["w"].as<string>();
     }
+    error_name = output_name.string() + ".err";
+    summary_name = output_name.string() + ".summary";
+    if (vm.count("summary")) {  // set summary file name
+        summary_name = vm["summary"].as<string>();
+    }
+    if (vm.count("e")) {    // set error log name
+        error_name = vm["e"].as<string>();
+    }
     if (vm.count("v")) {
         log_level = VERBOSE;
     }
@@ -117,24 +308,106 @@ int main( int argc, char* argv[] )
     if (vm.count("r")) {	// turn recursion on for driver program
         recurse_flag = true;
     }
+    if (vm.count("sample")) {	// approximate analysis on a tile subsample
+        options.sample = vm["sample"].as<double>();
+        if (options.sample <= 0 || options.sample > 1) {
+            cerr << "--sample takes a fraction in (0,1], usage: ./analyze --help for more info" << endl;
+            return 1;
+        }
+    }
+    if (vm.count("pyramid")) {	// multi-scale features
+        options.levels = vm["pyramid"].as<int>();
+        if (options.levels < 1) {
+            cerr << "--pyramid takes a level count of at least 1, usage: ./analyze --help for more info" << endl;
+            return 1;
+        }
+    }
+    if (vm.count("j")) {	// fixed number of workers
+        jobs = vm["j"].as<unsigned int>();
+    }
+    if (vm.count("budget")) {	// per image time limit
+        budget = vm["budget"].as<double>();
+        if (budget < 0) {
+            cerr << "--budget takes a positive number of seconds, usage: ./analyze --help for more info" << endl;
+            return 1;
+        }
+    }
+    if (vm.count("max-mem")) {	// admit images within a memory budget
+        if (!parse_mem(vm["max-mem"].as<string>(), max_mem)) {
+            cerr << "--max-mem takes a size such as 512M or 16G, usage: ./analyze --help for more info" << endl;
+            return 1;
+        }
+    }
+    if (vm.count("prefetch")) {	// readahead window
+        prefetch_window = vm["prefetch"].as<unsigned int>();
+    }
+    if (vm.count("show")) {	// windows and keypresses need a single worker
+        options.show = true;
+        jobs = 1;
+        budget = 0;     // waiting on a keypress would trip the watchdog
+    }
+    if (jobs == 0) {
+        jobs = std::max(boost::thread::hardware_concurrency(), 1u);
+    }
     // END OPTIONS PARSE
 
 
     // DRIVER & PATH ITERATION
     try {
         search_path(target_path, recurse_flag);
-        cout << "found [" << working_set.size() << "] workable jpg files." << endl;
-        vector<path>::iterator iter = working_set.begin();
-        imgutil iu(iter->string());
-        formatter fm(iu, output_name.c_str());  // initialize formatter
-        iter++;
-
-        while(iter != working_set.end()) {  // print stats for rest of set
-            imgutil iu(iter->string());
-            fm.append(iu);
-            iter++;
-        }
-        fm.close(); // close file stream
+        prescan_set();
+        cout << "found [" << scanned_set.size() << "] workable jpg files." << endl;
+        if (scanned_set.empty()) {
+            return 0;
+        }
+
+        const unsigned int workers = std::min<size_t>(jobs, scanned_set.size());
+
+        // largest images go out first so no worker is left with a long tail,
+        // as many run at once as fit in max_mem, the next few files are
+        // read ahead while the workers decode
+        scheduler sched(scanned_set, max_mem, prefetch_window);
+        work = &sched;
+        dog = new watchdog(budget, worker, abandon_image);
+        boost::thread output_thread(writer);
+        if (options.show) {    // stay on the main thread, highgui needs it
+            worker(dog->enlist());
+        }
+        else {
+            for (unsigned int i = 0; i < workers; i++) {
+                dog->spawn();
+            }
+            dog->wait_idle();
+        }
+        dog->stop();    // no replacement can start past this point
+        dog->release_threads();
+        {
+            boost::mutex::scoped_lock guard(queue_lock);
+            workers_done = true;
+            queued.notify_all();
+        }
+        output_thread.join();
+
+        if (fm != NULL) {
+            fm->close(); // close file stream
+            delete fm;
+            sums->write(summary_name.string());
+            delete sums;
+        }
+        if (error_log.is_open()) {
+            error_log.close();
+            cerr << "some images failed, see " << error_name.string() << endl;
+        }
+        // an abandoned worker may still be inside an image and would run
+        // into the scheduler and globals as they are destroyed, the output
+        // is closed so the process ends here without unwinding
+        if (dog->any_abandoned()) {
+            cout.flush();
+            cerr.flush();
+            _exit(0);
+        }
+        delete dog;
+        dog = NULL;
     }
     catch (const filesystem_error& ex) {
         cout << ex.what() << endl;
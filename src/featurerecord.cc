@@ -0,0 +1,73 @@
+/*  filename:   featurerecord.cc
+ *  version:    alpha
+ *  descript:   featureset and featurerecord implementation, swaps only
+ *              exchange vector buffers so no results are copied
+ */
+
+#include "featurerecord.h"
+#include <algorithm>
+
+featureset::featureset()
+        : mean_blue(0), mean_green(0), mean_red(0),
+          median_blue(0), median_green(0), median_red(0),
+          sumLaplace_all(0), sumLaplace_blue(0), sumLaplace_green(0), sumLaplace_red(0),
+          ci_mean_blue(0), ci_mean_green(0), ci_mean_red(0),
+          ci_median_blue(0), ci_median_green(0), ci_median_red(0),
+          ci_sumLaplace_all(0), ci_sumLaplace_blue(0), ci_sumLaplace_green(0), ci_sumLaplace_red(0) {
+}
+
+void featureset::swap(featureset &o) {
+    std::swap(mean_blue, o.mean_blue);
+    std::swap(mean_green, o.mean_green);
+    std::swap(mean_red, o.mean_red);
+    std::swap(median_blue, o.median_blue);
+    std::swap(median_green, o.median_green);
+    std::swap(median_red, o.median_red);
+    std::swap(sumLaplace_all, o.sumLaplace_all);
+    std::swap(sumLaplace_blue, o.sumLaplace_blue);
+    std::swap(sumLaplace_green, o.sumLaplace_green);
+    std::swap(sumLaplace_red, o.sumLaplace_red);
+    sumCanny_all.swap(o.sumCanny_all);
+    sumCanny_blue.swap(o.sumCanny_blue);
+    sumCanny_green.swap(o.sumCanny_green);
+    sumCanny_red.swap(o.sumCanny_red);
+    sumBinLaplace_blue.swap(o.sumBinLaplace_blue);
+    sumBinLaplace_green.swap(o.sumBinLaplace_green);
+    sumBinLaplace_red.swap(o.sumBinLaplace_red);
+    std::swap(ci_mean_blue, o.ci_mean_blue);
+    std::swap(ci_mean_green, o.ci_mean_green);
+    std::swap(ci_mean_red, o.ci_mean_red);
+    std::swap(ci_median_blue, o.ci_median_blue);
+    std::swap(ci_median_green, o.ci_median_green);
+    std::swap(ci_median_red, o.ci_median_red);
+    std::swap(ci_sumLaplace_all, o.ci_sumLaplace_all);
+    std::swap(ci_sumLaplace_blue, o.ci_sumLaplace_blue);
+    std::swap(ci_sumLaplace_green, o.ci_sumLaplace_green);
+    std::swap(ci_sumLaplace_red, o.ci_sumLaplace_red);
+    ci_sumCanny_all.swap(o.ci_sumCanny_all);
+    ci_sumCanny_blue.swap(o.ci_sumCanny_blue);
+    ci_sumCanny_green.swap(o.ci_sumCanny_green);
+    ci_sumCanny_red.swap(o.ci_sumCanny_red);
+    ci_sumBinLaplace_blue.swap(o.ci_sumBinLaplace_blue);
+    ci_sumBinLaplace_green.swap(o.ci_sumBinLaplace_green);
+    ci_sumBinLaplace_red.swap(o.ci_sumBinLaplace_red);
+}
+
+featurerecord::featurerecord()
+        : sampled(false), levels(1),
+          doColors(false), doSumLaplace(false), doSumCanny(false), doSumBinLaplace(false) {
+}
+
+void featurerecord::swap(featurerecord &o) {
+    name.swap(o.name);
+    std::swap(sampled, o.sampled);
+    std::swap(levels, o.levels);
+    std::swap(doColors, o.doColors);
+    std::swap(doSumLaplace, o.doSumLaplace);
+    std::swap(doSumCanny, o.doSumCanny);
+    std::swap(doSumBinLaplace, o.doSumBinLaplace);
+    base.swap(o.base);
+    norm.swap(o.norm);
+    base_levels.swap(o.base_levels);
+    norm_levels.swap(o.norm_levels);
+}
@@ -0,0 +1,47 @@
+/*  filename:   featurerecord.h
+ *  version:    alpha
+ *  descript:   compact numeric results of one image, all the formatter
+ *              needs once the image matrices are gone
+ */
+
+#ifndef FEATURERECORD_H_
+#define FEATURERECORD_H_
+
+#include <string>
+#include <vector>
+
+// results for one container, the base or norm image or a pyramid level
+struct featureset {
+    double mean_blue, mean_green, mean_red;
+    int median_blue, median_green, median_red;
+    double sumLaplace_all, sumLaplace_blue, sumLaplace_green, sumLaplace_red;
+    std::vector<double> sumCanny_all, sumCanny_blue, sumCanny_green, sumCanny_red;
+    std::vector<double> sumBinLaplace_blue, sumBinLaplace_green, sumBinLaplace_red;
+    // 95% confidence half-widths, only set when features are sampled
+    double ci_mean_blue, ci_mean_green, ci_mean_red;
+    double ci_median_blue, ci_median_green, ci_median_red;
+    double ci_sumLaplace_all, ci_sumLaplace_blue, ci_sumLaplace_green, ci_sumLaplace_red;
+    std::vector<double> ci_sumCanny_all, ci_sumCanny_blue, ci_sumCanny_green, ci_sumCanny_red;
+    std::vector<double> ci_sumBinLaplace_blue, ci_sumBinLaplace_green, ci_sumBinLaplace_red;
+
+    featureset();
+    void swap(featureset &other);
+};
+
+// everything written for one image, swapped rather than copied on its way
+// from a worker to the writer
+struct featurerecord {
+    std::string name;       // name given is derived from filename
+    bool sampled;           // all sums and colors are estimates
+    int levels;             // pyramid levels, 1 = full resolution only
+    bool doColors, doSumLaplace, doSumCanny, doSumBinLaplace;
+    featureset base;
+    featureset norm;
+    std::vector<featureset> base_levels;    // pyramid levels 1..
+    std::vector<featureset> norm_levels;
+
+    featurerecord();
+    void swap(featurerecord &other);
+};
+
+#endif /* FEATURERECORD_H_ */
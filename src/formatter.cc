@@ -7,20 +7,31 @@
  */
 
 #include "formatter.h"
+#include <sstream>
 
-// ctor has two parameters, the first imgutil to be formatted and the
+// ctor has two parameters, the first record to be formatted and the
 // file name for the output stream
-formatter::formatter(imgutil &iu, std::string filename) {
+formatter::formatter(const featurerecord &rec, std::string filename) {
     output.open(filename.c_str());
-    get_labels(iu);
+    get_labels(rec);
     set_labels();
     output << std::endl;
-    set_stats(iu);
+    set_stats(rec);
 }
 
 // appends another files data to the output file
-void formatter::append(imgutil &iu) {
-    set_stats(iu);
+void formatter::append(const featurerecord &rec) {
+    set_stats(rec);
+}
+
+// full column names in output order, without the filename column
+const std::vector<std::string> &formatter::get_columns() const {
+    return columns;
+}
+
+// values of the most recently written row
+const std::vector<double> &formatter::last_row() const {
+    return row;
 }
 
 // closes file output stream - prints newline at EOF
@@ -28,174 +39,175 @@ void formatter::close() {
     output.close();
 }
 
-// sets labels for base and normalized image variables
+// sets labels for base and normalized image variables, pyramid levels
+// follow with the level number in the prefix e.g. base-L1-
 void formatter::set_labels() {
-    std::vector<std::pair<std::string,int> >::iterator iter = labels.begin();
-    while (iter != labels.end()) {
-        output << "base-" << iter->first << "\t";
-        iter++;
+    print_labels("base-", labels);
+    print_labels("norm-", labels);
+    for (int level = 1; level < levels; level++) {
+        std::ostringstream base_prefix, norm_prefix;
+        base_prefix << "base-L" << level << "-";
+        norm_prefix << "norm-L" << level << "-";
+        print_labels(base_prefix.str(), level_labels);
+        print_labels(norm_prefix.str(), level_labels);
     }
-    iter = labels.begin();
-    while (iter != labels.end()) {
-        output << "norm-" << iter->first << "\t";
+}
+
+// prints the labels of set and records the full column names, threshold
+// columns get their level appended there
+void formatter::print_labels(std::string prefix, std::vector<std::pair<std::string,int> > &set) {
+    std::vector<std::pair<std::string,int> >::iterator iter = set.begin();
+    while (iter != set.end()) {
+        output << prefix << iter->first << "\t";
+        std::ostringstream column;
+        column << prefix << iter->first;
+        if (iter->second >= 0) {
+            column << "_" << iter->second;
+        }
+        columns.push_back(column.str());
         iter++;
     }
 }
 
-// gets all available labels for the image set
-void formatter::get_labels(imgutil &iu){
-    std::pair<std::string,int> temp;
-
-    if(iu.doColors == true) {
-        temp = std::make_pair("mean_blue",0);
-        labels.push_back(temp);
-        temp = std::make_pair("mean_green",0);
-        labels.push_back(temp);
-        temp = std::make_pair("mean_red",0);
-        labels.push_back(temp);
-        temp = std::make_pair("median_blue",0);
-        labels.push_back(temp);
-        temp = std::make_pair("median_green",0);
-        labels.push_back(temp);
-        temp = std::make_pair("median_red",0);
-        labels.push_back(temp);
+// pushes a label for each threshold level (or a single label marked -1
+// when levels is 0), followed by matching 95% interval labels for sampled
+// runs
+void formatter::push_labels(std::vector<std::pair<std::string,int> > &set,
+        std::string name, int levels, bool ci) {
+    if (levels == 0) {
+        set.push_back(std::make_pair(name,-1));
+        if (ci) {
+            set.push_back(std::make_pair(name + "_ci95",-1));
+        }
+        return;
     }
-
-    if(iu.doSumLaplace == true) {
-        temp = std::make_pair("sumLaplace_all",0);
-        labels.push_back(temp);
-        temp = std::make_pair("sumLaplace_blue",0);
-        labels.push_back(temp);
-        temp = std::make_pair("sumLaplace_green",0);
-        labels.push_back(temp);
-        temp = std::make_pair("sumLaplace_red",0);
-        labels.push_back(temp);
+    for (int threshold_level = 0; threshold_level<levels; threshold_level++) {
+        set.push_back(std::make_pair(name,threshold_level));
     }
-
-    if(iu.doSumCanny == true) {
-        for (int threshold_level = 0; threshold_level<=26; threshold_level++) {
-            temp = std::make_pair("sumCanny_all",threshold_level);
-            labels.push_back(temp);
-        }
-        for (int threshold_level = 0; threshold_level<=26; threshold_level++) {
-            temp = std::make_pair("sumCanny_blue",threshold_level);
-            labels.push_back(temp);
-        }
-        for (int threshold_level = 0; threshold_level<=26; threshold_level++) {
-            temp = std::make_pair("sumCanny_green",threshold_level);
-            labels.push_back(temp);
-        }
-        for (int threshold_level = 0; threshold_level<=26; threshold_level++) {
-            temp = std::make_pair("sumCanny_red",threshold_level);
-            labels.push_back(temp);
+    if (ci) {
+        for (int threshold_level = 0; threshold_level<levels; threshold_level++) {
+            set.push_back(std::make_pair(name + "_ci95",threshold_level));
         }
     }
+}
+
+// gets all available labels for the image set, pyramid levels carry the
+// edge and Laplace families only
+void formatter::get_labels(const featurerecord &rec){
+    levels = rec.levels;
+
+    if(rec.doColors == true) {
+        push_labels(labels,"mean_blue",0,rec.sampled);
+        push_labels(labels,"mean_green",0,rec.sampled);
+        push_labels(labels,"mean_red",0,rec.sampled);
+        push_labels(labels,"median_blue",0,rec.sampled);
+        push_labels(labels,"median_green",0,rec.sampled);
+        push_labels(labels,"median_red",0,rec.sampled);
+    }
 
-    if(iu.doSumBinLaplace == true) {
-        for (int threshold_level = 0; threshold_level<=26; threshold_level++) {
-            temp = std::make_pair("sumBinLaplace_blue",threshold_level);
-            labels.push_back(temp);
+    for (int pass = 0; pass < 2; pass++) {
+        std::vector<std::pair<std::string,int> > &set = pass == 0 ? labels : level_labels;
+
+        if(rec.doSumLaplace == true) {
+            push_labels(set,"sumLaplace_all",0,rec.sampled);
+            push_labels(set,"sumLaplace_blue",0,rec.sampled);
+            push_labels(set,"sumLaplace_green",0,rec.sampled);
+            push_labels(set,"sumLaplace_red",0,rec.sampled);
         }
-        for (int threshold_level = 0; threshold_level<=26; threshold_level++) {
-            temp = std::make_pair("sumBinLaplace_green",threshold_level);
-            labels.push_back(temp);
+
+        if(rec.doSumCanny == true) {
+            push_labels(set,"sumCanny_all",27,rec.sampled);
+            push_labels(set,"sumCanny_blue",27,rec.sampled);
+            push_labels(set,"sumCanny_green",27,rec.sampled);
+            push_labels(set,"sumCanny_red",27,rec.sampled);
         }
-        for (int threshold_level = 0; threshold_level<=26; threshold_level++) {
-            temp = std::make_pair("sumBinLaplace_red",threshold_level);
-            labels.push_back(temp);
+
+        if(rec.doSumBinLaplace == true) {
+            push_labels(set,"sumBinLaplace_blue",27,rec.sampled);
+            push_labels(set,"sumBinLaplace_green",27,rec.sampled);
+            push_labels(set,"sumBinLaplace_red",27,rec.sampled);
         }
     }
 }
 
-void formatter::set_stats(imgutil &iu) {
-    output << iu.name << "\t";  //prints filename stats relate to
+void formatter::set_stats(const featurerecord &rec) {
+    output << rec.name << "\t";  //prints filename stats relate to
+    row.clear();
 
     // BASE IMAGE
-    if(iu.doColors == true) {
-        output << iu.base.mean_blue << "\t";
-        output << iu.base.mean_green << "\t";
-        output << iu.base.mean_red << "\t";
-        output << iu.base.median_blue << "\t";
-        output << iu.base.median_green << "\t";
-        output << iu.base.median_red << "\t";
-    }
-
-    if(iu.doSumLaplace == true) {
-        output << iu.base.sumLaplace_all << "\t";
-        output << iu.base.sumLaplace_blue << "\t";
-        output << iu.base.sumLaplace_green << "\t";
-        output << iu.base.sumLaplace_red << "\t";
+    set_container_stats(rec, rec.base, true);
+    // NORMALIZED IMAGE
+    set_container_stats(rec, rec.norm, true);
+    // PYRAMID LEVELS
+    for (size_t level = 0; level < rec.base_levels.size(); level++) {
+        set_container_stats(rec, rec.base_levels[level], false);
+        set_container_stats(rec, rec.norm_levels[level], false);
     }
 
-    if(iu.doSumCanny == true) {
-        for (int threshold_level = 0; threshold_level<=26; threshold_level++) {
-            output << iu.base.sumCanny_all.at(threshold_level) << "\t";
-        }
-        for (int threshold_level = 0; threshold_level<=26; threshold_level++) {
-            output << iu.base.sumCanny_blue.at(threshold_level) << "\t";
-        }
-        for (int threshold_level = 0; threshold_level<=26; threshold_level++) {
-            output << iu.base.sumCanny_green.at(threshold_level) << "\t";
-        }
-        for (int threshold_level = 0; threshold_level<=26; threshold_level++) {
-            output << iu.base.sumCanny_red.at(threshold_level) << "\t";
-        }
+    for (size_t i = 0; i < row.size(); i++) {
+        output << row[i] << "\t";
     }
+    output << std::endl;    // end this file's stats with a new line
+}
 
-    if(iu.doSumBinLaplace == true) {
-        for (int threshold_level = 0; threshold_level<=26; threshold_level++) {
-            output << iu.base.sumBinLaplace_blue.at(threshold_level) << "\t";
-        }
-        for (int threshold_level = 0; threshold_level<=26; threshold_level++) {
-            output << iu.base.sumBinLaplace_blue.at(threshold_level) << "\t";
-        }
-        for (int threshold_level = 0; threshold_level<=26; threshold_level++) {
-            output << iu.base.sumBinLaplace_blue.at(threshold_level) << "\t";
-        }
-    }
-    // NORMALIZED IMAGE
-    if(iu.doColors == true) {
-        output << iu.norm.mean_blue << "\t";
-        output << iu.norm.mean_green << "\t";
-        output << iu.norm.mean_red << "\t";
-        output << iu.norm.median_blue << "\t";
-        output << iu.norm.median_green << "\t";
-        output << iu.norm.median_red << "\t";
+// appends the stats of one container to row in the same order as
+// get_labels, interval columns follow their values when sampled
+void formatter::set_container_stats(const featurerecord &rec, const featureset &c, bool full_scale) {
+    const bool ci = rec.sampled;
+
+    if(rec.doColors == true && full_scale) {
+        row.push_back(c.mean_blue);
+        if (ci) row.push_back(c.ci_mean_blue);
+        row.push_back(c.mean_green);
+        if (ci) row.push_back(c.ci_mean_green);
+        row.push_back(c.mean_red);
+        if (ci) row.push_back(c.ci_mean_red);
+        row.push_back(c.median_blue);
+        if (ci) row.push_back(c.ci_median_blue);
+        row.push_back(c.median_green);
+        if (ci) row.push_back(c.ci_median_green);
+        row.push_back(c.median_red);
+        if (ci) row.push_back(c.ci_median_red);
     }
 
-    if(iu.doSumLaplace == true) {
-        output << iu.norm.sumLaplace_all << "\t";
-        output << iu.norm.sumLaplace_blue << "\t";
-        output << iu.norm.sumLaplace_green << "\t";
-        output << iu.norm.sumLaplace_red << "\t";
+    if(rec.doSumLaplace == true) {
+        row.push_back(c.sumLaplace_all);
+        if (ci) row.push_back(c.ci_sumLaplace_all);
+        row.push_back(c.sumLaplace_blue);
+        if (ci) row.push_back(c.ci_sumLaplace_blue);
+        row.push_back(c.sumLaplace_green);
+        if (ci) row.push_back(c.ci_sumLaplace_green);
+        row.push_back(c.sumLaplace_red);
+        if (ci) row.push_back(c.ci_sumLaplace_red);
     }
 
-    if(iu.doSumCanny == true) {
-        for (int threshold_level = 0; threshold_level<=26; threshold_level++) {
-            output << iu.norm.sumCanny_all.at(threshold_level) << "\t";
-        }
-        for (int threshold_level = 0; threshold_level<=26; threshold_level++) {
-            output << iu.norm.sumCanny_blue.at(threshold_level) << "\t";
-        }
-        for (int threshold_level = 0; threshold_level<=26; threshold_level++) {
-            output << iu.norm.sumCanny_green.at(threshold_level) << "\t";
-        }
-        for (int threshold_level = 0; threshold_level<=26; threshold_level++) {
-            output << iu.norm.sumCanny_red.at(threshold_level) << "\t";
+    if(rec.doSumCanny == true) {
+        const std::vector<double> *sums[4] = { &c.sumCanny_all, &c.sumCanny_blue, &c.sumCanny_green, &c.sumCanny_red };
+        const std::vector<double> *cis[4] = { &c.ci_sumCanny_all, &c.ci_sumCanny_blue, &c.ci_sumCanny_green, &c.ci_sumCanny_red };
+        for (int k = 0; k < 4; k++) {
+            for (int threshold_level = 0; threshold_level<=26; threshold_level++) {
+                row.push_back(sums[k]->at(threshold_level));
+            }
+            if (ci) {
+                for (int threshold_level = 0; threshold_level<=26; threshold_level++) {
+                    row.push_back(cis[k]->at(threshold_level));
+                }
+            }
         }
     }
 
-    if(iu.doSumBinLaplace == true) {
-        for (int threshold_level = 0; threshold_level<=26; threshold_level++) {
-            output << iu.norm.sumBinLaplace_blue.at(threshold_level) << "\t";
-        }
-        for (int threshold_level = 0; threshold_level<=26; threshold_level++) {
-            output << iu.norm.sumBinLaplace_blue.at(threshold_level) << "\t";
-        }
-        for (int threshold_level = 0; threshold_level<=26; threshold_level++) {
-            output << iu.norm.sumBinLaplace_blue.at(threshold_level) << "\t";
+    if(rec.doSumBinLaplace == true) {
+        const std::vector<double> *bins[3] = { &c.sumBinLaplace_blue, &c.sumBinLaplace_green, &c.sumBinLaplace_red };
+        const std::vector<double> *cis[3] = { &c.ci_sumBinLaplace_blue, &c.ci_sumBinLaplace_green, &c.ci_sumBinLaplace_red };
+        for (int k = 0; k < 3; k++) {
+            for (int threshold_level = 0; threshold_level<=26; threshold_level++) {
+                row.push_back(bins[k]->at(threshold_level));
+            }
+            if (ci) {
+                for (int threshold_level = 0; threshold_level<=26; threshold_level++) {
+                    row.push_back(cis[k]->at(threshold_level));
+                }
+            }
         }
     }
-
-    output << std::endl;    // end this file's stats with a new line
 }
@@ -9,24 +9,32 @@
 #ifndef FORMATTER_H_
 #define FORMATTER_H_
 
-#include "imgutil.h"
+#include "featurerecord.h"
 #include <string>
 #include <vector>
 #include <fstream>
 
-class imgutil;  // forward declaration
-
 class formatter {
 public:
-    formatter(imgutil &iu, std::string filename);
-    void append(imgutil &iu);
+    formatter(const featurerecord &rec, std::string filename);
+    void append(const featurerecord &rec);
     void close();
+    const std::vector<std::string> &get_columns() const;
+    const std::vector<double> &last_row() const;
 private:
     std::vector<std::pair<std::string,int> > labels;
+    std::vector<std::pair<std::string,int> > level_labels;  // pyramid levels
+    int levels;
+    std::vector<std::string> columns;   // unique names for the summary
+    std::vector<double> row;            // values of the row being written
     std::ofstream output;
-    void get_labels(imgutil &iu);
+    void get_labels(const featurerecord &rec);
     void set_labels();
-    void set_stats(imgutil &iu);
+    void print_labels(std::string prefix, std::vector<std::pair<std::string,int> > &set);
+    void set_stats(const featurerecord &rec);
+    void set_container_stats(const featurerecord &rec, const featureset &c, bool full_scale);
+    void push_labels(std::vector<std::pair<std::string,int> > &set,
+            std::string name, int levels, bool ci);
 };
 
 #endif /* FORMATTER_H_ */
@@ -0,0 +1,69 @@
+/*  filename:   imgload.cc
+ *  version:    alpha
+ *  descript:   input layer implementation. The file is read into memory
+ *              in one pass and decoded from there, and the readahead hints
+ *              keep the disk busy while the workers decode.
+ */
+
+#include "imgload.h"
+#include "imgutil.h"
+// opencv headers
+#include <highgui.h>
+// c++ headers
+#include <cerrno>
+#include <climits>
+#include <vector>
+// posix headers
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// A plain read rather than a mapping: an I/O error or a file truncated
+// under a mapping would raise SIGBUS inside the decoder, read reports it.
+cv::Mat load_image(const std::string &filename) {
+    cv::Mat image;
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return image;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        close(fd);
+        return image;
+    }
+    if (info.st_size > INT_MAX) {   // imdecode takes an int sized buffer
+        close(fd);
+        throw imgerror("image file larger than 2GB");
+    }
+    // the file is read front to back exactly once
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    std::vector<uchar> buffer(info.st_size);
+    size_t filled = 0;
+    while (filled < buffer.size()) {
+        ssize_t got = read(fd, &buffer[filled], buffer.size() - filled);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {     // read error, or the file shrank
+            close(fd);
+            return image;
+        }
+        filled += got;
+    }
+    close(fd);
+
+    // imdecode allocates the decoded image itself
+    cv::Mat encoded(1, (int)buffer.size(), CV_8UC1, &buffer[0]);
+    image = cv::imdecode(encoded, 1);
+    return image;
+}
+
+void prefetch(const std::string &filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;     // load_image will report it
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    close(fd);
+}
@@ -0,0 +1,22 @@
+/*  filename:   imgload.h
+ *  version:    alpha
+ *  descript:   header for the input layer, images are read in one pass,
+ *              decoded from memory and upcoming files are read ahead
+ */
+
+#ifndef IMGLOAD_H_
+#define IMGLOAD_H_
+
+// opencv headers
+#include <cv.h>
+// c++ headers
+#include <string>
+
+// decodes the image in filename as 8 bit BGR, empty matrix on failure,
+// throws imgerror for files too large to decode
+cv::Mat load_image(const std::string &filename);
+
+// asks the kernel to start reading filename in the background
+void prefetch(const std::string &filename);
+
+#endif /* IMGLOAD_H_ */
@@ -7,120 +7,307 @@
  */
 
 #include "imgutil.h"
+#include "imgload.h"
 
-#define MCC CV_MAKETYPE(image.depth(),3)    // 3 channel M.T. same depth
-#define SCC CV_MAKETYPE(image.depth(),1)    // single channel M.T. same depth
-#define SC32F CV_MAKETYPE(CV_32F,1)         // single channel with 32F depth
+#define MCC CV_MAKETYPE(c.depth,3)          // 3 channel M.T. same depth
+#define SCC CV_MAKETYPE(c.depth,1)          // single channel M.T. same depth
 #define HIST_SIZE 256
 #define BLUE_LAYER 0
 #define GREEN_LAYER 1
 #define RED_LAYER 2
+#define BIN_LEVELS 27           // threshold levels for binned sums
+#define TILE_SIZE 32            // side of a sampled tile in pixels
+#define TILE_PAD 8              // margin read around a sampled tile
+#define STRATA 4                // strata per image side when sampling
+#define SAMPLE_SEED 0x5eed      // fixed so sampled runs are repeatable
+#define Z_95 1.959964           // normal quantile for 95% intervals
+
+// feature families run on every image, footprint() depends on these
+static const bool DO_COLORS = true;
+static const bool DO_SUM_LAPLACE = true;
+static const bool DO_SUM_CANNY = true;
+static const bool DO_SUM_BIN_LAPLACE = true;
+
+// per tile feature layout used when sampling
+enum tilefeatures {
+    F_SUM_BLUE, F_SUM_GREEN, F_SUM_RED,
+    F_LAP_ALL, F_LAP_BLUE, F_LAP_GREEN, F_LAP_RED,
+    F_BIN_BLUE,
+    F_BIN_GREEN = F_BIN_BLUE + BIN_LEVELS,
+    F_BIN_RED = F_BIN_GREEN + BIN_LEVELS,
+    F_CANNY_ALL = F_BIN_RED + BIN_LEVELS,
+    F_CANNY_BLUE = F_CANNY_ALL + BIN_LEVELS,
+    F_CANNY_GREEN = F_CANNY_BLUE + BIN_LEVELS,
+    F_CANNY_RED = F_CANNY_GREEN + BIN_LEVELS,
+    F_TOTAL = F_CANNY_RED + BIN_LEVELS
+};
 
 using namespace cv;
 using namespace std;
 
+// threshold used at each level of the binned sums
+static double bin_threshold(int level) {
+    if (level == 0) {
+        return 1;
+    }
+    if (level == BIN_LEVELS-1) {
+        return 255;
+    }
+    return 10*level;
+}
+
+// value at cumulative fraction p of a weighted 256 bin histogram
+static int hist_quantile(const vector<double> &hist, double p) {
+    double total = 0;
+    for (int v = 0; v < HIST_SIZE; v++) {
+        total += hist[v];
+    }
+    double target = std::min(std::max(p, 0.0), 1.0) * total;
+    double running = 0;
+    for (int v = 0; v < HIST_SIZE; v++) {
+        running += hist[v];
+        if (running >= target && running > 0) {
+            return v;
+        }
+    }
+    return HIST_SIZE-1;
+}
+
+// value at 0 based rank of the weighted pixels a histogram counts
+static int hist_rank(const vector<double> &hist, double rank) {
+    double running = 0;
+    for (int v = 0; v < HIST_SIZE; v++) {
+        running += hist[v];
+        if (running > rank) {
+            return v;
+        }
+    }
+    return HIST_SIZE-1;
+}
+
+// median as get_medians defines it, the middle value of an odd count and
+// the truncated mean of the two middle values of an even one
+static int hist_median(const vector<double> &hist) {
+    double total = 0;
+    for (int v = 0; v < HIST_SIZE; v++) {
+        total += hist[v];
+    }
+    const double count = floor(total + 0.5);
+    if (count < 1) {
+        return 0;
+    }
+    const double target = floor(count / 2);
+    if (fmod(count, 2.0) == 1) {
+        return hist_rank(hist, target);
+    }
+    return (hist_rank(hist, target - 1) + hist_rank(hist, target)) / 2.0;
+}
+
 
 // public methods
-imgutil::imgutil(string filename) {
+imgutil::imgutil(string filename, const imgopts &options) {
 
     // initialize flags
-    doColors = true;
-    doSumLaplace = true;
-    doSumCanny = true;
-    doSumBinLaplace = true;
+    doColors = DO_COLORS;
+    doSumLaplace = DO_SUM_LAPLACE;
+    doSumCanny = DO_SUM_CANNY;
+    doSumBinLaplace = DO_SUM_BIN_LAPLACE;
     doSumFourier = false;           // not implemented
     doSumBinFourier = false;        // not implemented
     doSumLonersFourier = false;     // not implemented
     doSumBinLonersFourier = false;  // not implemented
 
-    // initialize base and get image data
-    name = filename;
-	image = imread(filename,1);
-	image_norm = imread(filename,1);
-	base.data = image;
-	norm.data = image_norm;
-	// setting up containers for base and norm
-	base.height = image.rows;
-	base.width = image.cols;
-    base.depth = image.depth();
-	base.dimension = image.dims;
-    base.channels = image.channels();
-	base.type = image.type();
-    norm.height = image.rows;
-    norm.width = image.cols;
-    norm.depth = image.depth();
-    norm.dimension = image.dims;
-    norm.channels = image.channels();
-    norm.type = image.type();
-
-	// CV's NORMALIZE
-    // cv::normalize(base.data, norm.data, 0, 255, NORM_MINMAX);
-    // NORMALIZE
-	normalize(norm);
-	show_image(base.data);
-	show_image(norm.data);
+    opts = options;
+    sampled = opts.sample > 0;
+
+    record.name = filename;
+    record.sampled = sampled;
+    record.levels = opts.levels;
+    record.doColors = doColors;
+    record.doSumLaplace = doSumLaplace;
+    record.doSumCanny = doSumCanny;
+    record.doSumBinLaplace = doSumBinLaplace;
+    record.base_levels.resize(std::max(opts.levels - 1, 0));
+    record.norm_levels.resize(std::max(opts.levels - 1, 0));
 
+    // initialize base and get image data
+	// read and decoded once
+	base.data = load_image(filename);
+	if (base.data.empty()) {
+	    throw imgerror("unreadable or truncated image");
+	}
+	set_dims(base);
     is_workable(base);  // check to see if valid image
+
+	if (sampled && opts.levels == 1 && !opts.show) {
+	    // sampled tiles are normalized as they are cut, nothing reads the
+	    // rest of the normalized frame
+	    norm.data = base.data;
+	    norm.raw = true;
+	}
+	else {
+	    norm.data = base.data.clone();
+	    // CV's NORMALIZE
+	    // cv::normalize(base.data, norm.data, 0, 255, NORM_MINMAX);
+	    // NORMALIZE
+	    normalize(norm);
+	    boost::this_thread::interruption_point();
+	}
+	set_dims(norm);
     is_workable(norm);
 
+	if (opts.show) {
+	    show_image(base.data);
+	    show_image(norm.data);
+	}
+
     // get image info and print to term
     //get_info(base);
     //get_info(norm);
 
-    // initialize channels
-    init_channels(base);
-    init_channels(norm);
+	// base is finished and released before norm is split, so only one
+	// container's intermediates are alive at a time
+	cvcontainer *containers[2] = { &base, &norm };
+	featureset *stats[2] = { &record.base, &record.norm };
+	vector<featureset> *levels[2] = { &record.base_levels, &record.norm_levels };
+	for (int k = 0; k < 2; k++) {
+	    cvcontainer &c = *containers[k];
+	    c.stats = stats[k];
+
+	    // full resolution features
+	    analyze(c, true);
+
+	    // coarser scales, each level is reduced from the one above it
+	    build_pyramid(c, *levels[k]);
+	    c.data.release();
+	}
+}
 
-	// split channels gray, blue, green, red
-	split_channels(base);
-	split_channels(norm);
+void imgutil::take_record(featurerecord &out) {
+    out.swap(record);
+}
 
-	// forward dft transform on all channels
-	fourier_transform(base);
-	fourier_transform(norm);
+// runs the enabled feature families on one container, colors are only
+// computed at full resolution
+void imgutil::analyze(cvcontainer &c, bool full_scale) {
+	if (sampled) {
+	    // every sum comes from tiles
+	    sample_features(c);
+	    return;
+	}
 
-	if (doColors) {
-	    analyze_colors(base);
-	    analyze_colors(norm);
+	// split channels gray, blue, green, red
+	split_channels(c);
+	boost::this_thread::interruption_point();
+
+	// each family builds its own Laplacians and frees them when done, so
+	// at most one family's scratch is alive next to the planes
+	if (doColors && full_scale) {
+	    analyze_colors(c);
 	}
 	if (doSumLaplace) {
-	    sumLaplace(base);
-	    sumLaplace(norm);
-	}
-	if (doSumCanny) {
-	    sumCanny(base);
-	    sumCanny(norm);
+	    sumLaplace(c);
 	}
 	if (doSumBinLaplace) {
-	    sumBinLaplace(base);
-	    sumBinLaplace(norm);
+	    sumBinLaplace(c);
+	}
+	if (doSumCanny) {
+	    sumCanny(c);
 	}
+	release(c);
 }
 
+// analyzes one pyrDown level of top per entry in levels. A level is
+// reduced from the previous level so the whole pyramid costs about a third
+// of the full resolution work on top of it, and only the level above the
+// current one is kept.
+void imgutil::build_pyramid(cvcontainer &top, vector<featureset> &levels) {
+    Mat prev = top.data;
+    for (size_t l = 0; l < levels.size(); l++) {
+        cvcontainer c;
+        pyrDown(prev, c.data);
+        prev = c.data;
+        set_dims(c);
+        c.stats = &levels[l];
+
+        analyze(c, false);
+        boost::this_thread::interruption_point();
+    }
+}
 
-// creates matrices of correct size and type
-void imgutil::init_channels(cvcontainer &c) {
-
-    c.data.convertTo(c.data_8UC3, CV_8UC3); // get 8UC3 typed matrix
+// fills in size and type of the container from its data
+void imgutil::set_dims(cvcontainer &c) {
+    c.height = c.data.rows;
+    c.width = c.data.cols;
+    c.depth = c.data.depth();
+    c.dimension = c.data.dims;
+    c.channels = c.data.channels();
+    c.type = c.data.type();
+}
 
-    c.gray_channel.create(c.height, c.width, SCC);
-    c.blue_channel.create(c.height, c.width, SCC);
-    c.green_channel.create(c.height, c.width, SCC);
-    c.red_channel.create(c.height, c.width, SCC);
+// drops the intermediates of an analyzed container, data stays for the
+// pyramid
+void imgutil::release(cvcontainer &c) {
+    c.bgr_planes.clear();
+    c.gray_channel.release();
+    c.blue_channel.release();
+    c.green_channel.release();
+    c.red_channel.release();
+    c.laplace_all.release();
+    c.laplace_blue.release();
+    c.laplace_green.release();
+    c.laplace_red.release();
+}
 
-    c.fourier_gray.create(c.height, c.width, SC32F);
-    c.fourier_blue.create(c.height, c.width, SC32F);
-    c.fourier_green.create(c.height, c.width, SC32F);
-    c.fourier_red.create(c.height, c.width, SC32F);
+// Estimated peak bytes held while analyzing a width x height image with
+// the given options. Base and norm are analyzed one after the other, so
+// the peak is one container's working set plus the other decoded image.
+// Per pixel of a container: decoded image (3), gray and split planes (4),
+// and the largest of the per family scratch, as each family frees its own
+// before the next starts: median vectors (3), Laplacian (3), channel
+// Laplacians and their thresholded copies (3 + 3) or Canny (4 outputs,
+// plus 16 bit dx and dy and the edge map it allocates inside, 5). Pyramid
+// levels add about a third of a container without colors. Sampling only keeps the decoded frames, tiles are small enough
+// to ignore.
+double imgutil::footprint(int width, int height, const imgopts &options) {
+    const double pixels = (double)width * height;
+
+    if (options.sample > 0) {
+        // tiles are cut from the decoded image, the normalized frame and
+        // its pyramid only exist when levels are asked for
+        double bytes = 3 * pixels;
+        if (options.levels > 1 || options.show) {
+            bytes += 3 * pixels;
+        }
+        if (options.levels > 1) {
+            bytes += 3 * pixels * (1.0 - pow(0.25, options.levels - 1)) / 3.0;
+        }
+        return bytes;
+    }
 
-    c.laplace_all.create(c.height, c.width, c.type);
-    c.laplace_blue.create(c.height, c.width, SCC);
-    c.laplace_green.create(c.height, c.width, SCC);
-    c.laplace_red.create(c.height, c.width, SCC);
+    const double planes = 3 + 4;
+    double scratch = 0;
+    if (DO_SUM_LAPLACE) {
+        scratch = std::max(scratch, 3.0);
+    }
+    if (DO_SUM_BIN_LAPLACE) {
+        scratch = std::max(scratch, 3.0 + 3.0);
+    }
+    if (DO_SUM_CANNY) {
+        scratch = std::max(scratch, 4.0 + 5.0);
+    }
+    const double level = planes + scratch;
+    const double full = planes + std::max(scratch, DO_COLORS ? 3.0 : 0.0);
 
+    double bytes = (full + 3) * pixels;
+    if (options.levels > 1) {
+        // levels shrink by 4 each, the sum approaches a third
+        bytes += level * pixels * (1.0 - pow(0.25, options.levels - 1)) / 3.0;
+    }
+    return bytes;
 }
 
-// splits image into all channels, and gets 32F typed version as well
+// splits image into all channels
 void imgutil::split_channels(cvcontainer &c) {
 
       split(c.data, c.bgr_planes);
@@ -128,52 +315,38 @@ void imgutil::split_channels(cvcontainer &c) {
       c.blue_channel = c.bgr_planes[BLUE_LAYER];
       c.green_channel = c.bgr_planes[GREEN_LAYER];
       c.red_channel = c.bgr_planes[RED_LAYER];
-      c.blue_channel.convertTo(c.blue_channel_32F, CV_32FC1);
-      c.green_channel.convertTo(c.green_channel_32F, CV_32FC1);
-      c.red_channel.convertTo(c.red_channel_32F, CV_32FC1);
-      c.gray_channel.convertTo(c.gray_channel_32F, CV_32FC1);
-      // now have all channels, and 32FC1 typed matrix of each channel.
-
-      Laplacian(c.data,c.laplace_all,c.depth);
-      Laplacian(c.blue_channel,c.laplace_blue,c.depth);
-      Laplacian(c.green_channel,c.laplace_green,c.depth);
-      Laplacian(c.red_channel,c.laplace_red,c.depth);
-
+      // now have all channels
 
       // IMPORTANT ---- IF IMAGE IS CONVERTED TO 8UC3 and already is 8UC3 it is   <------------------------ FIX
       // NOT going to work.
 }
 
-void imgutil::fourier_transform(cvcontainer &c) {
-    // forward dft calculations
-    dft(c.gray_channel_32F,c.fourier_gray, CV_DXT_FORWARD);
-    dft(c.blue_channel_32F,c.fourier_blue, CV_DXT_FORWARD);
-    dft(c.green_channel_32F,c.fourier_green, CV_DXT_FORWARD);
-    dft(c.red_channel_32F,c.fourier_red, CV_DXT_FORWARD);
-}
-
 // takes mean and median of the image channels
 void imgutil::analyze_colors(cvcontainer &c) {
 
-    c.mean_image = mean(c.data);
-    c.mean_blue = c.mean_image.val[BLUE_LAYER];
-    c.mean_green = c.mean_image.val[GREEN_LAYER];
-    c.mean_red = c.mean_image.val[RED_LAYER];
+    Scalar mean_image = mean(c.data);
+    c.stats->mean_blue = mean_image.val[BLUE_LAYER];
+    c.stats->mean_green = mean_image.val[GREEN_LAYER];
+    c.stats->mean_red = mean_image.val[RED_LAYER];
 
     get_medians(c);
 }
 
 void imgutil::sumLaplace(cvcontainer &c) {
+    Laplacian(c.data,c.laplace_all,c.depth);
+    boost::this_thread::interruption_point();
+
     // convert to 8bit image if not already
     if (c.laplace_all.depth() != CV_8U) {
         c.laplace_all.convertTo(c.laplace_all,CV_8U);
     }
 
     Scalar sumLaplace = sum(c.laplace_all);
-    c.sumLaplace_blue = sumLaplace.val[BLUE_LAYER];
-    c.sumLaplace_green = sumLaplace.val[GREEN_LAYER];
-    c.sumLaplace_red = sumLaplace.val[RED_LAYER];
-    c.sumLaplace_all = c.sumLaplace_blue + c.sumLaplace_green + c.sumLaplace_red;
+    c.stats->sumLaplace_blue = sumLaplace.val[BLUE_LAYER];
+    c.stats->sumLaplace_green = sumLaplace.val[GREEN_LAYER];
+    c.stats->sumLaplace_red = sumLaplace.val[RED_LAYER];
+    c.stats->sumLaplace_all = c.stats->sumLaplace_blue + c.stats->sumLaplace_green + c.stats->sumLaplace_red;
+    c.laplace_all.release();    // last reader
 
 }
 
@@ -187,6 +360,7 @@ void imgutil::sumCanny(cvcontainer &c){
     const int threshold_a = 1;
     int threshold_b;
     for (int i = 0; i <= 26; i++) {
+        boost::this_thread::interruption_point();   // watchdog may cancel
         if (i == 0) {
             threshold_b = 1;
         }
@@ -210,14 +384,19 @@ void imgutil::sumCanny(cvcontainer &c){
         green_sum = sum(canny_green);
         red_sum = sum(canny_red);
 
-        c.sumCanny_all.push_back(all_sum.val[0]);
-        c.sumCanny_blue.push_back(blue_sum.val[0]);
-        c.sumCanny_green.push_back(green_sum.val[0]);
-        c.sumCanny_red.push_back(red_sum.val[0]);
+        c.stats->sumCanny_all.push_back(all_sum.val[0]);
+        c.stats->sumCanny_blue.push_back(blue_sum.val[0]);
+        c.stats->sumCanny_green.push_back(green_sum.val[0]);
+        c.stats->sumCanny_red.push_back(red_sum.val[0]);
     }
 }
 
 void imgutil::sumBinLaplace(cvcontainer &c) {
+    Laplacian(c.blue_channel,c.laplace_blue,c.depth);
+    Laplacian(c.green_channel,c.laplace_green,c.depth);
+    Laplacian(c.red_channel,c.laplace_red,c.depth);
+    boost::this_thread::interruption_point();
+
     // create necessary matrices
     Mat binLaplace_blue(c.height,c.width,SCC);
     Mat binLaplace_green(c.height,c.width,SCC);
@@ -227,6 +406,7 @@ void imgutil::sumBinLaplace(cvcontainer &c) {
     double threshold;
 
     for (int i =0; i <= 26; i++) {
+        boost::this_thread::interruption_point();
         if (i == 0) {
             threshold = 1;
         }
@@ -239,8 +419,8 @@ void imgutil::sumBinLaplace(cvcontainer &c) {
 
         // thresholding layers
         cv::threshold(c.laplace_blue, binLaplace_blue, threshold, MAX_THRESHOLD, THRESH_BINARY);
-        cv::threshold(c.laplace_green, binLaplace_blue, threshold, MAX_THRESHOLD, THRESH_BINARY);
-        cv::threshold(c.laplace_red, binLaplace_blue, threshold, MAX_THRESHOLD, THRESH_BINARY);
+        cv::threshold(c.laplace_green, binLaplace_green, threshold, MAX_THRESHOLD, THRESH_BINARY);
+        cv::threshold(c.laplace_red, binLaplace_red, threshold, MAX_THRESHOLD, THRESH_BINARY);
 
         // sum matrices
         Scalar blue_sum, green_sum, red_sum;
@@ -248,9 +428,210 @@ void imgutil::sumBinLaplace(cvcontainer &c) {
         green_sum = sum(binLaplace_green);
         red_sum = sum(binLaplace_red);
 
-        c.sumBinLaplace_blue.push_back(blue_sum.val[0]);
-        c.sumBinLaplace_green.push_back(green_sum.val[0]);
-        c.sumBinLaplace_red.push_back(red_sum.val[0]);
+        c.stats->sumBinLaplace_blue.push_back(blue_sum.val[0]);
+        c.stats->sumBinLaplace_green.push_back(green_sum.val[0]);
+        c.stats->sumBinLaplace_red.push_back(red_sum.val[0]);
+    }
+    // last reader of the channel Laplacians
+    c.laplace_blue.release();
+    c.laplace_green.release();
+    c.laplace_red.release();
+}
+
+// Estimates colors and the Laplace, binned Laplace and Canny sums from a
+// stratified sample of tiles. The image is cut into STRATA x STRATA strata of tiles,
+// each stratum contributes opts.sample of its tiles, and per tile totals
+// are scaled back up with the stratified estimator. Confidence half-widths
+// come from the within stratum variance of the tile totals.
+void imgutil::sample_features(cvcontainer &c) {
+    const int tile_rows = (c.height + TILE_SIZE - 1) / TILE_SIZE;
+    const int tile_cols = (c.width + TILE_SIZE - 1) / TILE_SIZE;
+    const double pixels = (double)c.height * c.width;
+    const Rect frame(0, 0, c.width, c.height);
+
+    RNG rng(SAMPLE_SEED);
+    vector<double> estimate(F_TOTAL, 0.0), variance(F_TOTAL, 0.0);
+    vector<double> totals(F_TOTAL);
+    // weighted pixel histograms per channel for the medians
+    vector<vector<double> > color_hist(3, vector<double>(HIST_SIZE, 0.0));
+    int tiles_sampled = 0;
+
+    for (int sy = 0; sy < STRATA; sy++) {
+        boost::this_thread::interruption_point();
+        for (int sx = 0; sx < STRATA; sx++) {
+            const int r0 = sy * tile_rows / STRATA, r1 = (sy+1) * tile_rows / STRATA;
+            const int c0 = sx * tile_cols / STRATA, c1 = (sx+1) * tile_cols / STRATA;
+            const int span = c1 - c0;
+            const int N = (r1 - r0) * span;
+            if (N == 0) {
+                continue;
+            }
+            // at least two tiles so the stratum variance is defined
+            int n = cvRound(opts.sample * N);
+            n = std::min(std::max(n, std::min(2, N)), N);
+
+            // partial Fisher-Yates picks n distinct tiles
+            vector<int> ids(N);
+            for (int i = 0; i < N; i++) {
+                ids[i] = i;
+            }
+            for (int i = 0; i < n; i++) {
+                std::swap(ids[i], ids[i + rng.uniform(0, N - i)]);
+            }
+
+            vector<double> sum(F_TOTAL, 0.0), sumsq(F_TOTAL, 0.0);
+            for (int i = 0; i < n; i++) {
+                boost::this_thread::interruption_point();
+                Rect tile((c0 + ids[i] % span) * TILE_SIZE, (r0 + ids[i] / span) * TILE_SIZE,
+                        TILE_SIZE, TILE_SIZE);
+                tile_totals(c, tile & frame, totals, color_hist, (double)N / n);
+                for (int f = 0; f < F_TOTAL; f++) {
+                    sum[f] += totals[f];
+                    sumsq[f] += totals[f] * totals[f];
+                }
+            }
+
+            for (int f = 0; f < F_TOTAL; f++) {
+                double mean = sum[f] / n;
+                double s2 = n > 1 ? std::max(sumsq[f] - n * mean * mean, 0.0) / (n - 1) : 0.0;
+                estimate[f] += N * mean;
+                variance[f] += (double)N * N * (1.0 - (double)n / N) * s2 / n;
+            }
+            tiles_sampled += n;
+        }
+    }
+
+    vector<double> ci(F_TOTAL);
+    for (int f = 0; f < F_TOTAL; f++) {
+        ci[f] = Z_95 * sqrt(variance[f]);
+    }
+
+    c.stats->mean_blue = estimate[F_SUM_BLUE] / pixels;
+    c.stats->mean_green = estimate[F_SUM_GREEN] / pixels;
+    c.stats->mean_red = estimate[F_SUM_RED] / pixels;
+    c.stats->ci_mean_blue = ci[F_SUM_BLUE] / pixels;
+    c.stats->ci_mean_green = ci[F_SUM_GREEN] / pixels;
+    c.stats->ci_mean_red = ci[F_SUM_RED] / pixels;
+
+    // median interval from order statistics, tiles as the sample unit
+    const double spread = Z_95 * 0.5 / sqrt((double)std::max(tiles_sampled, 1));
+    int *medians[3] = { &c.stats->median_blue, &c.stats->median_green, &c.stats->median_red };
+    double *median_cis[3] = { &c.stats->ci_median_blue, &c.stats->ci_median_green, &c.stats->ci_median_red };
+    for (int k = 0; k < 3; k++) {
+        *medians[k] = hist_median(color_hist[k]);
+        *median_cis[k] = (hist_quantile(color_hist[k], 0.5 + spread) -
+                hist_quantile(color_hist[k], 0.5 - spread)) / 2.0;
+    }
+
+    c.stats->sumLaplace_all = estimate[F_LAP_ALL];
+    c.stats->sumLaplace_blue = estimate[F_LAP_BLUE];
+    c.stats->sumLaplace_green = estimate[F_LAP_GREEN];
+    c.stats->sumLaplace_red = estimate[F_LAP_RED];
+    c.stats->ci_sumLaplace_all = ci[F_LAP_ALL];
+    c.stats->ci_sumLaplace_blue = ci[F_LAP_BLUE];
+    c.stats->ci_sumLaplace_green = ci[F_LAP_GREEN];
+    c.stats->ci_sumLaplace_red = ci[F_LAP_RED];
+
+    for (int i = 0; i < BIN_LEVELS; i++) {
+        c.stats->sumBinLaplace_blue.push_back(estimate[F_BIN_BLUE + i]);
+        c.stats->sumBinLaplace_green.push_back(estimate[F_BIN_GREEN + i]);
+        c.stats->sumBinLaplace_red.push_back(estimate[F_BIN_RED + i]);
+        c.stats->ci_sumBinLaplace_blue.push_back(ci[F_BIN_BLUE + i]);
+        c.stats->ci_sumBinLaplace_green.push_back(ci[F_BIN_GREEN + i]);
+        c.stats->ci_sumBinLaplace_red.push_back(ci[F_BIN_RED + i]);
+        c.stats->sumCanny_all.push_back(estimate[F_CANNY_ALL + i]);
+        c.stats->sumCanny_blue.push_back(estimate[F_CANNY_BLUE + i]);
+        c.stats->sumCanny_green.push_back(estimate[F_CANNY_GREEN + i]);
+        c.stats->sumCanny_red.push_back(estimate[F_CANNY_RED + i]);
+        c.stats->ci_sumCanny_all.push_back(ci[F_CANNY_ALL + i]);
+        c.stats->ci_sumCanny_blue.push_back(ci[F_CANNY_BLUE + i]);
+        c.stats->ci_sumCanny_green.push_back(ci[F_CANNY_GREEN + i]);
+        c.stats->ci_sumCanny_red.push_back(ci[F_CANNY_RED + i]);
+    }
+}
+
+// fills totals with the per tile feature sums and adds the tile's pixels
+// to the color histograms with the given weight. The tile is cut with a
+// TILE_PAD margin and, for a raw container, normalized on its own copy.
+// The margin gives the Laplacian the same neighbours as the full frame, so
+// those sums match it exactly; Canny edges chained from further away than
+// the margin are lost, so its sums are slightly low.
+void imgutil::tile_totals(cvcontainer &c, Rect tile, vector<double> &totals,
+        vector<vector<double> > &color_hist, double weight) {
+    std::fill(totals.begin(), totals.end(), 0.0);
+    const bool need_laplace = doSumLaplace || doSumBinLaplace;
+
+    const Rect padded = Rect(tile.x - TILE_PAD, tile.y - TILE_PAD,
+            tile.width + 2*TILE_PAD, tile.height + 2*TILE_PAD) & Rect(0, 0, c.width, c.height);
+    const Rect inner(tile.x - padded.x, tile.y - padded.y, tile.width, tile.height);
+    cvcontainer patch;
+    patch.data = c.data(padded).clone();
+    if (c.raw) {
+        normalize(patch);
+    }
+    vector<Mat> planes;
+    split(patch.data, planes);
+
+    for (int k = 0; k < 3; k++) {
+        Mat roi = planes[k](inner);
+        totals[F_SUM_BLUE + k] = sum(roi).val[0];
+
+        if (doColors) {
+            for (int y = 0; y < roi.rows; y++) {
+                const uchar *row = roi.ptr<uchar>(y);
+                for (int x = 0; x < roi.cols; x++) {
+                    color_hist[k][row[x]] += weight;
+                }
+            }
+        }
+        if (!need_laplace) {
+            continue;
+        }
+
+        Mat lap;
+        Laplacian(planes[k], lap, c.depth);
+        lap = lap(inner);
+        int lap_hist[HIST_SIZE] = {0};
+        for (int y = 0; y < lap.rows; y++) {
+            const uchar *row = lap.ptr<uchar>(y);
+            for (int x = 0; x < lap.cols; x++) {
+                lap_hist[row[x]]++;
+            }
+        }
+
+        double lap_sum = 0;
+        for (int v = 0; v < HIST_SIZE; v++) {
+            lap_sum += (double)v * lap_hist[v];
+        }
+        totals[F_LAP_BLUE + k] = lap_sum;
+        totals[F_LAP_ALL] += lap_sum;
+
+        // binary threshold sets pixels above the level to 255
+        const int bin_base = F_BIN_BLUE + k * BIN_LEVELS;
+        for (int i = 0; i < BIN_LEVELS; i++) {
+            double above = 0;
+            for (int v = (int)bin_threshold(i) + 1; v < HIST_SIZE; v++) {
+                above += lap_hist[v];
+            }
+            totals[bin_base + i] = 255.0 * above;
+        }
+    }
+
+    if (doSumCanny) {
+        // same channels and thresholds as sumCanny
+        Mat gray, edges;
+        cvtColor(patch.data, gray, CV_BGR2GRAY);
+        for (int i = 0; i < BIN_LEVELS; i++) {
+            const double threshold_b = bin_threshold(i);
+            Canny(gray, edges, 1, threshold_b);
+            totals[F_CANNY_ALL + i] = 255.0 * countNonZero(edges(inner));
+            Canny(planes[BLUE_LAYER], edges, 1, threshold_b);
+            totals[F_CANNY_BLUE + i] = 255.0 * countNonZero(edges(inner));
+            Canny(planes[GREEN_LAYER], edges, 1, threshold_b);
+            totals[F_CANNY_GREEN + i] = 255.0 * countNonZero(edges(inner));
+            Canny(planes[RED_LAYER], edges, threshold_b, threshold_b);
+            totals[F_CANNY_RED + i] = 255.0 * countNonZero(edges(inner));
+        }
     }
 }
 
@@ -269,6 +650,7 @@ void imgutil::get_medians(cvcontainer &c) {
 
     int i=0;
     for (int y=0; y < c.data.rows; y++) {
+        boost::this_thread::interruption_point();
         for (int x=0; x < c.data.cols; x++) {
             Scalar intensity = c.blue_channel.at<uchar>(y, x);
             blue_intensities.push_back(intensity.val[0]);
@@ -288,37 +670,41 @@ void imgutil::get_medians(cvcontainer &c) {
     std::nth_element(red_intensities.begin(),red_intensities.begin()+target,red_intensities.end());
 
     if (size % 2 == 1) {    // ODD NO. of PIXELS
-        c.median_blue = blue_intensities.at(target);
-        c.median_green = green_intensities.at(target);
-        c.median_red = red_intensities.at(target);
+        c.stats->median_blue = blue_intensities.at(target);
+        c.stats->median_green = green_intensities.at(target);
+        c.stats->median_red = red_intensities.at(target);
     }
     else {
         int target_neighbor = target-1;
         std::nth_element(blue_intensities.begin(),blue_intensities.begin()+target_neighbor,blue_intensities.end());
         std::nth_element(green_intensities.begin(),green_intensities.begin()+target_neighbor,green_intensities.end());
         std::nth_element(red_intensities.begin(),red_intensities.begin()+target_neighbor,red_intensities.end());
-        c.median_blue = (blue_intensities.at(target) + blue_intensities.at(target_neighbor)) / 2.0;
-        c.median_green = (green_intensities.at(target) + green_intensities.at(target_neighbor)) / 2.0;
-        c.median_red = (red_intensities.at(target) + red_intensities.at(target_neighbor)) / 2.0;
+        c.stats->median_blue = (blue_intensities.at(target) + blue_intensities.at(target_neighbor)) / 2.0;
+        c.stats->median_green = (green_intensities.at(target) + green_intensities.at(target_neighbor)) / 2.0;
+        c.stats->median_red = (red_intensities.at(target) + red_intensities.at(target_neighbor)) / 2.0;
     }
 }
 
 // input is the container to be normalized
 void imgutil::normalize(cvcontainer &in) {
     for (int y=0; y < in.data.rows; y++) {
+        boost::this_thread::interruption_point();
         for (int x=0; x < in.data.cols; x++) {
             Vec3b intensity = in.data.at<Vec3b>(y, x);
             float blue = intensity.val[0];
             float green = intensity.val[1];
             float red = intensity.val[2];
             float sumbgr = blue + green + red;
+            if (sumbgr == 0) {
+                continue;       // black stays black
+            }
             blue = (blue/sumbgr)*255;
             green = (green/sumbgr) * 255;
             red = (red/sumbgr) * 255;
             intensity.val[0] = blue;
             intensity.val[1] = green;
             intensity.val[2] = red;
-            in.data.at<Vec3b>(x,y) = intensity;
+            in.data.at<Vec3b>(y,x) = intensity;
         }
     }
 }
@@ -355,12 +741,10 @@ string imgutil::get_depth(int depth) {
 // performs sanity checks on all files inputed
 void imgutil::is_workable(cvcontainer &c) {
     if (c.dimension != 2) {   // image must be 2D
-        cerr << "ERROR: not a workable image file [bad dimensions]" << endl;
-        exit(EXIT_FAILURE);
+        throw imgerror("not a workable image file [bad dimensions]");
     }
-    if (c.depth < 0 || image.depth() > 6) {   // not valid image type
-        cerr << "ERROR: not a workable image file [incorrect depth]" << endl;
-        exit(EXIT_FAILURE);
+    if (c.depth < 0 || c.depth > 6) {   // not valid image type
+        throw imgerror("not a workable image file [incorrect depth]");
     }
 }
 
@@ -9,7 +9,7 @@
 #ifndef _IMGUTIL_H
 #define _IMGUTIL_H
 
-#include "formatter.h"
+#include "featurerecord.h"
 // opencv headers
 #include <cv.h>
 #include <highgui.h>
@@ -17,56 +17,72 @@
 // c++ headers
 #include <iostream>
 #include <algorithm>
+#include <cmath>
 #include <vector>
 #include <string>
+#include <stdexcept>
 // boost headers
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/thread/thread.hpp>
 
+// thrown when an image can not be analyzed, the run carries on without it
+class imgerror : public std::runtime_error {
+public:
+    explicit imgerror(const std::string &what) : std::runtime_error(what) {}
+};
+
+// analysis options shared by every image in a run
+struct imgopts {
+    double sample;  // fraction of tiles analyzed per stratum, 0 = exact path
+    bool show;      // display base and norm images, blocks on a keypress
+    int levels;     // pyramid levels analyzed, 1 = full resolution only
+    imgopts() : sample(0.0), show(false), levels(1) {}
+};
+
+// Working context for one image. The constructor runs the analysis and
+// leaves only the compact featurerecord behind, every matrix is released
+// as soon as its last consumer has run.
 class imgutil {
 private:
 
-// class formats data for output
-    friend class formatter;
-
 //  runtime flags for all available methods
     bool doColors, doSumLaplace, doSumCanny, doSumBinLaplace,
     doSumFourier, doSumBinFourier, doSumLonersFourier, doSumBinLonersFourier;
 
-// structure cvcontainer holds data for the image analysis
+// structure cvcontainer holds the transient data for the image analysis
     struct cvcontainer {
         cv::Mat data;   // contains the image matrix
-        cv::Mat data_8UC3;  // CV_8U3C type image matrix (8bit 3 channels)
         int height,width,depth,dimension,channels,type;
         std::vector<cv::Mat> bgr_planes; // vector of all image channels
         cv::Mat gray_channel, blue_channel, green_channel, red_channel;
-        cv::Mat gray_channel_32F, blue_channel_32F, green_channel_32F, red_channel_32F;
-        cv::Mat fourier_gray, fourier_blue, fourier_green, fourier_red;
         cv::Mat laplace_all, laplace_blue, laplace_green, laplace_red;
-        cv::Scalar mean_image;
-        double mean_blue, mean_green, mean_red;
-        int median_blue, median_green, median_red;
-        double sumLaplace_all, sumLaplace_blue, sumLaplace_green, sumLaplace_red;
-        std::vector<double> sumCanny_all, sumCanny_blue, sumCanny_green, sumCanny_red;
-        std::vector<double> sumBinLaplace_blue, sumBinLaplace_green, sumBinLaplace_red;
+        featureset *stats;  // where this container's results go
+        bool raw;           // data is not normalized yet, sampled tiles are
+        cvcontainer() : stats(NULL), raw(false) {}
     };
 
-    std::string name;        // name given is derived from filename
+    imgopts opts;            // options the image was analyzed with
+    bool sampled;            // features are estimated from tiles
+    featurerecord record;    // results, outlives all the matrices
 
 //  image matrices required for image processing
-    cv::Mat image;  // raw image matrix
-    cv::Mat image_norm; // norm image matrix
 	cvcontainer base;   // starting base image
 	cvcontainer norm;   // starting normalize image [0-255]
 
-    void init_channels(cvcontainer &);   // initialize channels to size and type
+    void set_dims(cvcontainer &);        // fills size and type from data
+    void analyze(cvcontainer &, bool);   // runs enabled feature families
+    void build_pyramid(cvcontainer &, std::vector<featureset> &);
+    void release(cvcontainer &);         // drops all but data
 	void split_channels(cvcontainer &);  // splits image into channels
-	void fourier_transform(cvcontainer &);
 	void analyze_colors(cvcontainer &);  // calculates median and mean
 	void sumLaplace(cvcontainer &);
 	void sumCanny(cvcontainer &);
 	void sumBinLaplace(cvcontainer &);
 	void sumBinLonersFourier(cvcontainer &);
+	void sample_features(cvcontainer &); // stratified tile estimates
+	void tile_totals(cvcontainer &, cv::Rect, std::vector<double> &,
+	        std::vector<std::vector<double> > &, double);
 
     // utility methods for class
     void get_info(cvcontainer &);
@@ -79,7 +95,13 @@ private:
 
 public:
 
-	imgutil(std::string);	// ctor takes filename as only argument
+	// ctor takes filename and run options, throws imgerror on a bad image
+	// and boost::thread_interrupted when the watchdog cancels it
+	imgutil(std::string, const imgopts & = imgopts());
+	// hands the results over, leaving this imgutil empty
+	void take_record(featurerecord &out);
+	// peak memory estimate in bytes for an image of the given size
+	static double footprint(int width, int height, const imgopts &);
 
 };
 #endif
@@ -0,0 +1,116 @@
+/*  filename:   prescan.cc
+ *  version:    alpha
+ *  descript:   walks the jpeg marker segments up to the first frame
+ *              header, no image data is read or decoded
+ */
+
+#include "prescan.h"
+#include <fstream>
+
+// jpeg markers, see ITU T.81 table B.1
+#define M_SOI 0xD8
+#define M_EOI 0xD9
+#define M_SOS 0xDA
+#define M_TEM 0x01
+#define M_DHT 0xC4
+#define M_JPG 0xC8
+#define M_DAC 0xCC
+
+// SOF0 through SOF15 less the three markers sharing that range
+static bool is_sof(int marker) {
+    return marker >= 0xC0 && marker <= 0xCF &&
+            marker != M_DHT && marker != M_JPG && marker != M_DAC;
+}
+
+// markers that carry no length field
+static bool is_standalone(int marker) {
+    return marker == M_TEM || (marker >= 0xD0 && marker <= 0xD7);
+}
+
+static bool read_u16(std::ifstream &in, int &value) {
+    int hi = in.get();
+    int lo = in.get();
+    if (!in) {
+        return false;
+    }
+    value = (hi << 8) | lo;
+    return true;
+}
+
+bool prescan(const boost::filesystem::path &file, imginfo &info, std::string &reason) {
+    info.file = file;
+    std::ifstream in(file.string().c_str(), std::ios::in | std::ios::binary);
+    if (!in) {
+        reason = "unreadable";
+        return false;
+    }
+    if (in.get() != 0xFF || in.get() != M_SOI) {
+        reason = "not a jpeg [missing SOI]";
+        return false;
+    }
+
+    while (in) {
+        // markers start with 0xFF and may be padded with more 0xFF bytes
+        int byte = in.get();
+        if (!in) {
+            break;
+        }
+        if (byte != 0xFF) {
+            reason = "corrupt marker stream";
+            return false;
+        }
+        int marker;
+        do {
+            marker = in.get();
+        } while (marker == 0xFF);
+        if (!in) {
+            break;
+        }
+        if (is_standalone(marker)) {
+            continue;
+        }
+        if (marker == M_SOS || marker == M_EOI) {
+            reason = "no frame header before scan data";
+            return false;
+        }
+
+        int length;
+        if (!read_u16(in, length) || length < 2) {
+            break;
+        }
+        if (!is_sof(marker)) {
+            in.seekg(length - 2, std::ios::cur);
+            continue;
+        }
+
+        int precision = in.get();
+        int height, width;
+        if (!read_u16(in, height) || !read_u16(in, width)) {
+            break;
+        }
+        int components = in.get();
+        if (!in) {
+            break;
+        }
+        if (precision != 8) {
+            reason = "unsupported sample precision";
+            return false;
+        }
+        if (width == 0 || height == 0) {
+            reason = "bad dimensions";
+            return false;
+        }
+        if (components != 1 && components != 3 && components != 4) {
+            reason = "unsupported channel count";
+            return false;
+        }
+        info.width = width;
+        info.height = height;
+        info.channels = components;
+        // every feature is linear in the pixel count of the decoded image
+        info.cost = (double)width * height;
+        return true;
+    }
+    reason = "truncated header";
+    return false;
+}
@@ -0,0 +1,27 @@
+/*  filename:   prescan.h
+ *  version:    alpha
+ *  descript:   header for the jpeg prescan which reads only the frame
+ *              header of each file to size and validate the working set
+ */
+
+#ifndef PRESCAN_H_
+#define PRESCAN_H_
+
+#include <string>
+// boost headers
+#include <boost/filesystem.hpp>
+
+// what the prescan learns about one file without decoding it
+struct imginfo {
+    boost::filesystem::path file;
+    int width, height, channels;
+    double cost;    // relative work estimate used for scheduling
+    double bytes;   // peak memory estimate used for admission
+    imginfo() : width(0), height(0), channels(0), cost(0), bytes(0) {}
+};
+
+// parses the SOF header of a jpeg, returns false and sets reason if the
+// file can not be analyzed
+bool prescan(const boost::filesystem::path &file, imginfo &info, std::string &reason);
+
+#endif /* PRESCAN_H_ */
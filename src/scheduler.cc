@@ -0,0 +1,120 @@
+/*  filename:   scheduler.cc
+ *  version:    alpha
+ *  descript:   scheduler implementation, dispatching the largest images
+ *              first keeps every worker busy until the end of the run.
+ *              Images are only admitted while their estimated footprint
+ *              fits in the memory budget.
+ */
+
+#include "scheduler.h"
+#include "imgload.h"
+#include <algorithm>
+// boost headers
+#include <boost/thread/thread.hpp>
+
+// larger estimated cost sorts first
+static bool costlier(const imginfo &a, const imginfo &b) {
+    return a.cost > b.cost;
+}
+
+scheduler::scheduler(const std::vector<imginfo> &set, double mem, size_t ahead)
+        : total(set.size()), max_mem(mem), in_use(0), window(ahead), prefetched(0),
+          head_waited(false) {
+    std::vector<imginfo> sorted(set);
+    std::stable_sort(sorted.begin(), sorted.end(), costlier);
+    jobs.assign(sorted.begin(), sorted.end());
+}
+
+// hands out the most expensive image that fits in the memory left, and
+// waits for running images to finish when none does. While the head image
+// does not fit one smaller image may be started behind it, after that
+// room is kept for the head so the largest images can not be pushed to
+// the end of the run. An image bigger than the whole budget is still run
+// once nothing but stuck images is in flight. Each call tops up the
+// readahead of the next window images in dispatch order.
+bool scheduler::next(imginfo &job) {
+    // waiting here is not part of any image's time budget
+    boost::this_thread::disable_interruption no_interrupt;
+    std::vector<std::string> ahead;
+    bool found = take(job, ahead);
+    // the hints open files, so they go out after the lock is dropped
+    for (size_t i = 0; i < ahead.size(); i++) {
+        prefetch(ahead[i]);
+    }
+    return found;
+}
+
+// admission under the lock, also collects the files to read ahead
+bool scheduler::take(imginfo &job, std::vector<std::string> &ahead) {
+    boost::mutex::scoped_lock guard(lock);
+    for (;;) {
+        if (jobs.empty()) {
+            return false;
+        }
+        std::list<imginfo>::iterator pick = jobs.begin();
+        size_t position = 0;
+        // a stuck image stays charged, but it never finishes, so it alone
+        // does not hold back the head
+        const bool busy = in_flight.size() > stuck.size();
+        if (max_mem > 0 && busy && in_use + pick->bytes > max_mem) {
+            if (head_waited) {
+                pick = jobs.end();
+            }
+            else {
+                head_waited = true;
+                while (pick != jobs.end() && in_use + pick->bytes > max_mem) {
+                    ++pick;
+                    ++position;
+                }
+            }
+        }
+        if (pick != jobs.end()) {
+            if (pick == jobs.begin()) {
+                head_waited = false;
+            }
+            job = *pick;
+            if (position < prefetched) {    // it came out of the hinted prefix
+                prefetched--;
+            }
+            jobs.erase(pick);
+            std::list<imginfo>::iterator upcoming = jobs.begin();
+            std::advance(upcoming, std::min(prefetched, jobs.size()));
+            for (; prefetched < window && upcoming != jobs.end(); ++upcoming, ++prefetched) {
+                ahead.push_back(upcoming->file.string());
+            }
+            in_use += job.bytes;
+            in_flight[job.file.string()] += job.bytes;
+            return true;
+        }
+        freed.wait(guard);
+    }
+}
+
+void scheduler::done(const std::string &file) {
+    boost::mutex::scoped_lock guard(lock);
+    std::map<std::string, double>::iterator found = in_flight.find(file);
+    if (found == in_flight.end()) {
+        return;
+    }
+    in_use -= found->second;
+    in_flight.erase(found);
+    stuck.erase(file);
+    if (in_flight.empty()) {
+        in_use = 0;     // no rounding drift once idle
+    }
+    freed.notify_all();
+}
+
+// called when the image's worker is abandoned, its matrices are still
+// held so the bytes stay charged until the worker unwinds and calls done
+void scheduler::abandon(const std::string &file) {
+    boost::mutex::scoped_lock guard(lock);
+    if (in_flight.count(file)) {
+        stuck.insert(file);
+        freed.notify_all();
+    }
+}
+
+size_t scheduler::size() const {
+    return total;
+}
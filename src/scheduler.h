@@ -0,0 +1,45 @@
+/*  filename:   scheduler.h
+ *  version:    alpha
+ *  descript:   header for the scheduler which hands prescanned images
+ *              to the worker threads, most expensive first, within a
+ *              memory budget
+ */
+
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include "prescan.h"
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+// boost headers
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+class scheduler {
+public:
+    // max_mem is the budget in bytes for all images in flight, 0 = none,
+    // window is how many upcoming images are read ahead
+    scheduler(const std::vector<imginfo> &set, double max_mem = 0, size_t window = 0);
+    bool next(imginfo &job);    // false once the set is exhausted
+    void done(const std::string &file);    // releases the image's memory
+    void abandon(const std::string &file); // stuck, stays charged until done
+    size_t size() const;
+private:
+    std::list<imginfo> jobs;    // sorted by descending cost
+    size_t total;
+    double max_mem;
+    double in_use;              // estimated bytes of admitted images
+    size_t window;
+    size_t prefetched;          // leading pending jobs already read ahead
+    std::map<std::string, double> in_flight;
+    std::set<std::string> stuck;    // in flight on abandoned workers
+    bool head_waited;           // the head image has already been passed
+    boost::mutex lock;
+    boost::condition_variable freed;
+    bool take(imginfo &job, std::vector<std::string> &ahead);
+};
+
+#endif /* SCHEDULER_H_ */
@@ -0,0 +1,204 @@
+/*  filename:   summary.cc
+ *  version:    alpha
+ *  descript:   streaming summary implementation. Groups are the parent
+ *              directory of each image, the overall summary is kept
+ *              alongside them at full accuracy.
+ */
+
+#include "summary.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+
+#define ALL_GROUP "*"   // group name of the whole run
+#define PRECISION 12    // significant digits, sums run past a million
+#define ALL_K 200       // sketch capacity of the whole run
+#define GROUP_K 64      // starting sketch capacity of a directory
+#define MIN_GROUP_K 8   // directory sketches are not shrunk below this
+#define GROUP_VALUES (8 * 1024 * 1024)  // held by directory sketches, 64MB
+
+// quantiles written per column
+static const double QUANTILES[] = { 0.05, 0.25, 0.5, 0.75, 0.95 };
+static const int NUM_QUANTILES = sizeof(QUANTILES) / sizeof(QUANTILES[0]);
+
+welford::welford()
+        : n(0), mu(0), m2(0),
+          lo(std::numeric_limits<double>::infinity()),
+          hi(-std::numeric_limits<double>::infinity()) {
+}
+
+void welford::add(double x) {
+    n += 1;
+    double delta = x - mu;
+    mu += delta / n;
+    m2 += delta * (x - mu);
+    lo = std::min(lo, x);
+    hi = std::max(hi, x);
+}
+
+unsigned long welford::count() const {
+    return n;
+}
+
+double welford::mean() const {
+    return mu;
+}
+
+double welford::variance() const {
+    return n > 1 ? m2 / (double)(n - 1) : 0;
+}
+
+double welford::min() const {
+    return lo;
+}
+
+double welford::max() const {
+    return hi;
+}
+
+quantsketch::quantsketch(size_t size) : k(std::max<size_t>(size, 2)), levels(1), odd(0) {
+}
+
+void quantsketch::add(double x) {
+    levels[0].push_back(x);
+    if (levels[0].size() >= k) {
+        compact();
+    }
+}
+
+void quantsketch::shrink(size_t size) {
+    k = std::max<size_t>(size, 2);
+    compact();
+}
+
+size_t quantsketch::size() const {
+    size_t values = 0;
+    for (size_t h = 0; h < levels.size(); h++) {
+        values += levels[h].size();
+    }
+    return values;
+}
+
+// halves every full level into the one above it
+void quantsketch::compact() {
+    for (size_t h = 0; h < levels.size(); h++) {
+        if (levels[h].size() < k) {
+            continue;
+        }
+        if (h + 1 == levels.size()) {
+            levels.push_back(std::vector<double>());
+        }
+        std::vector<double> &level = levels[h];
+        std::sort(level.begin(), level.end());
+        // an odd value out stays behind so the weight is kept exactly
+        double leftover = 0;
+        bool has_leftover = level.size() % 2 == 1;
+        if (has_leftover) {
+            leftover = level.back();
+            level.pop_back();
+        }
+        const unsigned long bit = 1UL << (h % (8 * sizeof(odd)));
+        for (size_t i = (odd & bit) ? 1 : 0; i < level.size(); i += 2) {
+            levels[h + 1].push_back(level[i]);
+        }
+        odd ^= bit;
+        // a cleared vector keeps its capacity, thousands of directory
+        // sketches would hold on to all of it
+        std::vector<double>(has_leftover ? 1 : 0, leftover).swap(level);
+    }
+}
+
+double quantsketch::quantile(double q) const {
+    std::vector<std::pair<double, double> > weighted;
+    double total = 0;
+    for (size_t h = 0; h < levels.size(); h++) {
+        double weight = std::ldexp(1.0, (int)h);
+        for (size_t i = 0; i < levels[h].size(); i++) {
+            weighted.push_back(std::make_pair(levels[h][i], weight));
+            total += weight;
+        }
+    }
+    if (weighted.empty()) {
+        return 0;
+    }
+    std::sort(weighted.begin(), weighted.end());
+    double target = q * total;
+    double running = 0;
+    for (size_t i = 0; i < weighted.size(); i++) {
+        running += weighted[i].second;
+        if (running >= target) {
+            return weighted[i].first;
+        }
+    }
+    return weighted.back().first;
+}
+
+summary::summary(const std::vector<std::string> &names)
+        : columns(names), all(names.size(), columnstats(ALL_K)), group_k(GROUP_K), held(0) {
+}
+
+// folds one output row into the stats of the run and of its group
+void summary::add(const std::string &group, const std::vector<double> &row) {
+    groupstats &g = groups[group];
+    if (g.empty()) {
+        g.resize(columns.size(), columnstats(group_k));
+    }
+    for (size_t i = 0; i < row.size() && i < g.size(); i++) {
+        all[i].moments.add(row[i]);
+        all[i].sketch.add(row[i]);
+        g[i].moments.add(row[i]);
+        held -= g[i].sketch.size();
+        g[i].sketch.add(row[i]);
+        held += g[i].sketch.size();
+    }
+    while (held > GROUP_VALUES && group_k > MIN_GROUP_K) {
+        shrink_groups();
+    }
+}
+
+// halves the capacity of every directory sketch, which about halves the
+// values they hold
+void summary::shrink_groups() {
+    group_k = std::max<size_t>(group_k / 2, MIN_GROUP_K);
+    held = 0;
+    for (std::map<std::string, groupstats>::iterator g = groups.begin(); g != groups.end(); ++g) {
+        for (size_t i = 0; i < g->second.size(); i++) {
+            g->second[i].sketch.shrink(group_k);
+            held += g->second[i].sketch.size();
+        }
+    }
+}
+
+// one line per group and column, the whole run comes first as group *
+void summary::write(const std::string &filename) const {
+    std::ofstream out(filename.c_str());
+    out << std::setprecision(PRECISION);
+    out << "group\tcolumn\tn\tmean\tsd\tmin";
+    for (int i = 0; i < NUM_QUANTILES; i++) {
+        out << "\tq" << (int)(QUANTILES[i] * 100 + 0.5);
+    }
+    out << "\tmax" << std::endl;
+
+    write_group(out, ALL_GROUP, all);
+    for (std::map<std::string, groupstats>::const_iterator g = groups.begin(); g != groups.end(); ++g) {
+        write_group(out, g->first, g->second);
+    }
+    out.close();
+}
+
+void summary::write_group(std::ofstream &out, const std::string &name, const groupstats &g) const {
+    for (size_t i = 0; i < g.size(); i++) {
+        const welford &m = g[i].moments;
+        if (m.count() == 0) {
+            continue;
+        }
+        out << name << "\t" << columns[i] << "\t" << m.count() << "\t" << m.mean()
+                << "\t" << std::sqrt(m.variance()) << "\t" << m.min();
+        for (int q = 0; q < NUM_QUANTILES; q++) {
+            out << "\t" << g[i].sketch.quantile(QUANTILES[q]);
+        }
+        out << "\t" << m.max() << std::endl;
+    }
+}
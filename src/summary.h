@@ -0,0 +1,72 @@
+/*  filename:   summary.h
+ *  version:    alpha
+ *  descript:   header for the streaming per directory summaries, every
+ *              output column gets moments and quantiles without keeping
+ *              the rows
+ */
+
+#ifndef SUMMARY_H_
+#define SUMMARY_H_
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+// running count, mean and variance (Welford) plus the range
+class welford {
+public:
+    welford();
+    void add(double x);
+    unsigned long count() const;
+    double mean() const;
+    double variance() const;    // sample variance, 0 below two values
+    double min() const;
+    double max() const;
+private:
+    unsigned long n;
+    double mu, m2, lo, hi;
+};
+
+// Compacting quantile sketch. Level h holds values of weight 2^h; a full
+// level is sorted and every other value moves up a level. Rank error is
+// about log2(n/k)/k of n.
+class quantsketch {
+public:
+    explicit quantsketch(size_t k = 200);
+    void add(double x);
+    void shrink(size_t k);      // lowers the capacity, compacting to fit
+    size_t size() const;        // values held
+    double quantile(double q) const;
+private:
+    size_t k;
+    std::vector<std::vector<double> > levels;
+    unsigned long odd;          // bit h alternates which half of level h survives
+    void compact();
+};
+
+// per directory aggregates of every output column. The whole run keeps
+// full size sketches; directory sketches share a budget of held values
+// and all lose accuracy together when it runs out.
+class summary {
+public:
+    summary(const std::vector<std::string> &columns);
+    void add(const std::string &group, const std::vector<double> &row);
+    void write(const std::string &filename) const;
+private:
+    struct columnstats {
+        welford moments;
+        quantsketch sketch;
+        explicit columnstats(size_t k) : sketch(k) {}
+    };
+    typedef std::vector<columnstats> groupstats;
+    std::vector<std::string> columns;
+    groupstats all;             // the whole run
+    std::map<std::string, groupstats> groups;
+    size_t group_k;             // sketch capacity of the directory groups
+    size_t held;                // values held by the directory sketches
+    void shrink_groups();
+    void write_group(std::ofstream &out, const std::string &name, const groupstats &g) const;
+};
+
+#endif /* SUMMARY_H_ */
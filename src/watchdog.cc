@@ -0,0 +1,170 @@
+/*  filename:   watchdog.cc
+ *  version:    alpha
+ *  descript:   watchdog implementation. Overdue workers are interrupted,
+ *              imgutil polls for that between stages. A worker still busy
+ *              at twice the budget is stuck in a single OpenCV call, it is
+ *              abandoned and the driver replaces it.
+ */
+
+#include "watchdog.h"
+#include <vector>
+
+#define POLL_MS 100     // watchdog wake up interval
+
+using namespace boost::posix_time;
+
+watchdog::watchdog(double b, workerfn run, abandonfn f)
+        : budget(b), body(run), on_abandon(f), monitor_thread(NULL), stopping(false) {
+    if (budget > 0) {
+        monitor_thread = new boost::thread(&watchdog::monitor, this);
+    }
+}
+
+watchdog::~watchdog() {
+    stop();
+}
+
+void watchdog::stop() {
+    if (monitor_thread != NULL) {
+        {
+            boost::mutex::scoped_lock guard(lock);
+            stopping = true;
+        }
+        monitor_thread->join();
+        delete monitor_thread;
+        monitor_thread = NULL;
+    }
+}
+
+bool watchdog::any_abandoned() {
+    boost::mutex::scoped_lock guard(lock);
+    for (std::list<workerstate>::iterator w = workers.begin(); w != workers.end(); ++w) {
+        if (w->abandoned) {
+            return true;
+        }
+    }
+    return false;
+}
+
+workerstate *watchdog::enlist() {
+    boost::mutex::scoped_lock guard(lock);
+    workers.push_back(workerstate());
+    return &workers.back();
+}
+
+void watchdog::spawn() {
+    boost::mutex::scoped_lock guard(lock);
+    workers.push_back(workerstate());
+    start(&workers.back());
+}
+
+// called with the lock held, the new thread blocks on it before it can
+// report anything, so thread is always set by the time it exits
+void watchdog::start(workerstate *w) {
+    w->thread = new boost::thread(body, w);
+}
+
+// starts the clock on a new image
+void watchdog::begin(workerstate *w, const std::string &file) {
+    boost::mutex::scoped_lock guard(lock);
+    w->file = file;
+    w->started = microsec_clock::universal_time();
+    w->interrupted = false;
+}
+
+// stops the clock, the result may only be kept when FINISHED
+watchdog::outcome watchdog::end(workerstate *w) {
+    outcome result;
+    {
+        boost::mutex::scoped_lock guard(lock);
+        w->file.clear();
+        result = w->abandoned ? ABANDONED : w->interrupted ? OVERRAN : FINISHED;
+    }
+    // swallow an interrupt that landed after the last interruption point
+    // so it can not cancel the next image
+    try {
+        boost::this_thread::interruption_point();
+    }
+    catch (const boost::thread_interrupted &) {
+    }
+    return result;
+}
+
+bool watchdog::abandoned(workerstate *w) {
+    boost::mutex::scoped_lock guard(lock);
+    return w->abandoned;
+}
+
+void watchdog::exited(workerstate *w) {
+    boost::mutex::scoped_lock guard(lock);
+    w->exited = true;
+    changed.notify_all();
+}
+
+void watchdog::wait_idle() {
+    boost::mutex::scoped_lock guard(lock);
+    for (;;) {
+        bool busy = false;
+        for (std::list<workerstate>::iterator w = workers.begin(); w != workers.end(); ++w) {
+            busy = busy || (!w->exited && !w->abandoned);
+        }
+        if (!busy) {
+            return;
+        }
+        changed.wait(guard);
+    }
+}
+
+// stalled threads can not be joined, they are left to die with the process
+void watchdog::release_threads() {
+    boost::mutex::scoped_lock guard(lock);
+    for (std::list<workerstate>::iterator w = workers.begin(); w != workers.end(); ++w) {
+        if (w->thread == NULL) {
+            continue;
+        }
+        if (w->abandoned && !w->exited) {
+            w->thread->detach();
+        }
+        else {
+            w->thread->join();
+        }
+        delete w->thread;
+        w->thread = NULL;
+    }
+}
+
+void watchdog::monitor() {
+    const time_duration limit = microseconds((long)(budget * 1e6));
+    for (;;) {
+        std::vector<std::string> stalled;
+        {
+            boost::mutex::scoped_lock guard(lock);
+            if (stopping) {
+                return;
+            }
+            ptime now = microsec_clock::universal_time();
+            for (std::list<workerstate>::iterator w = workers.begin(); w != workers.end(); ++w) {
+                if (w->file.empty() || w->abandoned || w->thread == NULL) {
+                    continue;
+                }
+                time_duration elapsed = now - w->started;
+                if (elapsed > limit && !w->interrupted) {
+                    w->interrupted = true;
+                    w->thread->interrupt();
+                }
+                if (elapsed > limit * 2) {
+                    w->abandoned = true;
+                    stalled.push_back(w->file);
+                    // started under the lock so wait_idle keeps waiting
+                    workers.push_back(workerstate());
+                    start(&workers.back());
+                }
+            }
+        }
+        // outside the lock, the callback logs and frees the images
+        for (size_t i = 0; i < stalled.size(); i++) {
+            on_abandon(stalled[i]);
+        }
+        boost::this_thread::sleep(milliseconds(POLL_MS));
+    }
+}
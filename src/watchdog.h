@@ -0,0 +1,59 @@
+/*  filename:   watchdog.h
+ *  version:    alpha
+ *  descript:   header for the watchdog which enforces the per image time
+ *              budget of the worker threads
+ */
+
+#ifndef WATCHDOG_H_
+#define WATCHDOG_H_
+
+#include <list>
+#include <string>
+// boost headers
+#include <boost/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+// what the watchdog knows about one worker thread
+struct workerstate {
+    boost::thread *thread;
+    std::string file;           // image in progress, empty when idle
+    boost::posix_time::ptime started;
+    bool interrupted;           // over budget, interrupt was sent
+    bool abandoned;             // stalled past twice the budget
+    bool exited;
+    workerstate() : thread(NULL), interrupted(false), abandoned(false), exited(false) {}
+};
+
+class watchdog {
+public:
+    enum outcome { FINISHED, OVERRAN, ABANDONED };
+    typedef void (*workerfn)(workerstate *self);
+    // called with the stalled image once its replacement is running
+    typedef void (*abandonfn)(const std::string &file);
+
+    watchdog(double budget, workerfn body, abandonfn on_abandon);
+    ~watchdog();
+    workerstate *enlist();      // state for a worker run by the caller
+    void spawn();               // starts a worker thread running body
+    void begin(workerstate *w, const std::string &file);
+    outcome end(workerstate *w);
+    bool abandoned(workerstate *w);
+    void exited(workerstate *w);
+    void wait_idle();           // blocks until every live worker has exited
+    void release_threads();     // joins exited workers, detaches stalled ones
+    void stop();                // joins the monitor, no replacements after
+    bool any_abandoned();
+private:
+    double budget;              // seconds, 0 disables the watchdog
+    workerfn body;
+    abandonfn on_abandon;
+    std::list<workerstate> workers;
+    boost::mutex lock;
+    boost::condition_variable changed;
+    boost::thread *monitor_thread;
+    bool stopping;
+    void monitor();
+    void start(workerstate *w);
+};
+
+#endif /* WATCHDOG_H_ */